@@ -0,0 +1,61 @@
+#ifndef BENCH_NESTEDCMSKETCH_HH
+#define BENCH_NESTEDCMSKETCH_HH
+
+#include "utils/flowkey.hh"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// The Count-Min sketch as it was before sketch::CMSketch moved to one flat
+// counter array: a vector per row and an independent hash per row, with
+// update() and query() hashing every row separately. Kept only as the
+// baseline the CMSketch bench rows are compared against.
+template <typename hash_t>
+class NestedCMSketch {
+    int width_;
+    int depth_;
+    std::vector<std::vector<uint32_t>> sketch_;
+    std::vector<hash_t> hash_fns_;
+
+public:
+    NestedCMSketch(int width, int depth)
+            : width_(std::max(1, width)), depth_(depth), hash_fns_(depth) {
+        sketch_.resize(depth, std::vector<uint32_t>(width_, 0));
+    }
+
+    template <int32_t key_len>
+    void update(const FlowKey<key_len> &flowkey, int count = 1) {
+        for (int i = 0; i < depth_; ++i) {
+            uint32_t index = hash_fns_[i](flowkey) % width_;
+            sketch_[i][index] += count;
+        }
+    }
+
+    template <int32_t key_len>
+    uint32_t query(const FlowKey<key_len> &flowkey) const {
+        uint32_t min_count = std::numeric_limits<uint32_t>::max();
+        for (int i = 0; i < depth_; ++i) {
+            uint32_t index = hash_fns_[i](flowkey) % width_;
+            min_count = std::min(min_count, sketch_[i][index]);
+        }
+        return min_count;
+    }
+
+    // What the detectors did per packet before updateAndQuery() existed.
+    template <int32_t key_len>
+    uint32_t updateAndQuery(const FlowKey<key_len> &flowkey, int count = 1) {
+        update(flowkey, count);
+        return query(flowkey);
+    }
+
+    void clear() {
+        for (auto &row : sketch_) {
+            std::fill(row.begin(), row.end(), 0);
+        }
+    }
+
+    size_t size() const { return static_cast<size_t>(depth_) * width_ * sizeof(uint32_t); }
+};
+
+#endif // BENCH_NESTEDCMSKETCH_HH
@@ -0,0 +1,103 @@
+#ifndef BENCH_PERFCOUNTERS_HH
+#define BENCH_PERFCOUNTERS_HH
+
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// User-space hardware counters of the calling thread via perf_event_open.
+// Each event is opened on its own so that one unsupported event (common in
+// VMs) does not take the others down; an event that could not be opened
+// reads as -1. Values are scaled for multiplexing.
+class PerfCounters {
+public:
+    enum Event { CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, DTLB_MISSES, NUM_EVENTS };
+
+    PerfCounters() {
+        static const struct {
+            uint32_t type;
+            uint64_t config;
+        } events[NUM_EVENTS] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        };
+        for (int i = 0; i < NUM_EVENTS; ++i) {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[i].type;
+            attr.config = events[i].config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            values_[i] = -1;
+        }
+    }
+
+    ~PerfCounters() {
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    static const char *name(int event) {
+        static const char *names[NUM_EVENTS] = {"cycles", "instructions", "llc_misses", "branch_misses", "dtlb_misses"};
+        return names[event];
+    }
+
+    bool available() const {
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start() {
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    void stop() {
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int i = 0; i < NUM_EVENTS; ++i) {
+            values_[i] = -1;
+            uint64_t buf[3];
+            if (fds_[i] >= 0 && read(fds_[i], buf, sizeof(buf)) == sizeof(buf) && buf[2] > 0) {
+                values_[i] = static_cast<int64_t>(static_cast<double>(buf[0]) * buf[1] / buf[2]);
+            }
+        }
+    }
+
+    // Count from the last start()/stop() pair, -1 if unavailable.
+    int64_t value(int event) const { return values_[event]; }
+
+private:
+    int fds_[NUM_EVENTS];
+    int64_t values_[NUM_EVENTS];
+};
+
+#endif // BENCH_PERFCOUNTERS_HH
@@ -0,0 +1,380 @@
+// Per-detector microbenchmark: ns/packet and hardware counters over a
+// mem_size sweep, with warm and cold caches. Results go to stdout as JSON
+// or CSV; progress goes to stderr.
+//
+//   bench <settings.conf> [--format json|csv] [--mem 16384,131072,...]
+//         [--detectors JitterSketch,FDFilter,...] [--reps N]
+//         [--packets N] [--synthetic-flows N] [--evict-mb N]
+//
+// The trace is [general] data_file, or a synthetic one when that file does
+// not exist. Each (detector, mem_size, state) point is the fastest of reps
+// timed passes over the in-memory trace. "warm" starts right after clear(),
+// which has just written the whole structure; "cold" first streams
+// evict-mb of unrelated memory through the caches. An untimed priming pass
+// runs first, so event vectors already have their capacity and their
+// growth is not measured.
+//
+// "CMSketch" runs one row per Count-Min variant at the same byte budget:
+// the nested-vector baseline (NestedCMSketch), then sketch::CMSketch with
+// 32-, 16- and 8-bit counters, each plain and with conservative update
+// ("-cu"). Those rows also carry mean_error, the average overestimate over
+// the trace's flows after one pass; other rows leave it null.
+
+#include "bench/NestedCMSketch.hh"
+#include "bench/PerfCounters.hh"
+#include "experiment/DetectorFactory.hh"
+#include "sketch/BloomFilter.hh"
+#include "sketch/CMSketch.hh"
+#include "utils/core.hh"
+#include "utils/hash.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    struct Options {
+        std::string format = "json";
+        std::vector<long> mem_sizes = {16 << 10, 128 << 10, 1 << 20, 8 << 20, 64 << 20};
+        std::vector<std::string> detectors = {"JitterSketch", "JitterSketchS1Opt", "DelaySketch",
+                                              "FDFilter", "CMSketch", "BloomFilter"};
+        int reps = 3;
+        size_t packets = 0;          // 0 = whole trace
+        int synthetic_flows = 100000;
+        size_t evict_bytes = 64 << 20;
+    };
+
+    struct Result {
+        std::string detector;
+        long mem_size;
+        size_t bytes;
+        const char *state;
+        size_t packets;
+        double ns_per_packet;
+        int64_t counters[PerfCounters::NUM_EVENTS];
+        double mean_error = -1;      // < 0: not measured
+    };
+
+    // Count-Min rows share a depth so their widths follow from the budget.
+    constexpr int CM_DEPTH = 4;
+
+    // Packets per flow, for the Count-Min error.
+    using FlowCounts = std::unordered_map<FlowKey<13>, uint32_t, hash::FlowKeyHash>;
+
+    // Heavy-tailed flow sizes over `flows` flows, 1 us mean inter-arrival.
+    std::vector<core::Record> syntheticTrace(size_t packets, int flows) {
+        std::mt19937_64 rng(12345);
+        std::vector<FlowKey<13>> keys;
+        for (int i = 0; i < flows; ++i) {
+            uint64_t r = rng();
+            keys.emplace_back(static_cast<uint32_t>(r), static_cast<uint32_t>(r >> 32),
+                              static_cast<uint16_t>(rng()), static_cast<uint16_t>(rng()), 6);
+        }
+        std::exponential_distribution<double> gap(1.0);
+        std::vector<core::Record> records(packets);
+        double ts = 0;
+        for (size_t i = 0; i < packets; ++i) {
+            // Inverse of a Pareto-ish CDF: low ranks get most packets.
+            double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            size_t rank = static_cast<size_t>(flows * u * u * u);
+            ts += gap(rng);
+            records[i].flowkey_ = keys[std::min<size_t>(rank, flows - 1)];
+            records[i].timestamp_ = static_cast<uint64_t>(ts);
+            records[i].flag_ = 0;
+        }
+        return records;
+    }
+
+    void evictCaches(size_t bytes) {
+        static std::vector<uint64_t> junk;
+        junk.resize(bytes / sizeof(uint64_t));
+        for (size_t i = 0; i < junk.size(); i += 8) {
+            junk[i] += i;
+        }
+        volatile uint64_t sink = junk[junk.size() / 2];
+        (void)sink;
+    }
+
+    // clear_fn resets the structure, op_fn(record) processes one packet.
+    template <typename clear_fn, typename op_fn>
+    Result measure(const Options &opt, const std::vector<core::Record> &records, bool cold,
+                   clear_fn &&clear, op_fn &&op) {
+        PerfCounters perf;
+        Result best;
+        best.ns_per_packet = -1;
+        best.packets = records.size();
+        best.state = cold ? "cold" : "warm";
+
+        clear();
+        for (const auto &record : records) {
+            op(record);
+        }
+
+        for (int rep = 0; rep < opt.reps; ++rep) {
+            clear();
+            if (cold) {
+                evictCaches(opt.evict_bytes);
+            }
+            perf.start();
+            auto start = std::chrono::steady_clock::now();
+            for (const auto &record : records) {
+                op(record);
+            }
+            auto end = std::chrono::steady_clock::now();
+            perf.stop();
+
+            double ns = std::chrono::duration<double, std::nano>(end - start).count() / records.size();
+            if (best.ns_per_packet < 0 || ns < best.ns_per_packet) {
+                best.ns_per_packet = ns;
+                for (int e = 0; e < PerfCounters::NUM_EVENTS; ++e) {
+                    best.counters[e] = perf.value(e);
+                }
+            }
+        }
+        return best;
+    }
+
+    template <typename sketch_t>
+    void benchDetector(const Options &opt, const std::vector<core::Record> &records, const std::string &name,
+                       long mem_size, sketch_t &sketch, std::vector<Result> &results) {
+        for (bool cold : {false, true}) {
+            Result r = measure(opt, records, cold,
+                               [&]() {
+                                   sketch.clear();
+                                   sketch.setInitTime(records[0].timestamp_);
+                               },
+                               [&](const core::Record &record) { sketch.update(record.flowkey_, record.timestamp_); });
+            r.detector = name;
+            r.mem_size = mem_size;
+            r.bytes = sketch.size();
+            results.push_back(r);
+        }
+    }
+
+    // cm is left holding one pass over the trace by measure(), which is
+    // what its error is taken over.
+    template <typename cm_t>
+    void benchCMSketch(const Options &opt, const std::vector<core::Record> &records, const FlowCounts &truth,
+                       const std::string &name, long mem_size, cm_t &cm, std::vector<Result> &results) {
+        uint32_t sink = 0;
+        for (bool cold : {false, true}) {
+            Result r = measure(opt, records, cold, [&]() { cm.clear(); },
+                               [&](const core::Record &record) { sink += cm.updateAndQuery(record.flowkey_); });
+            double error = 0;
+            for (const auto &flow : truth) {
+                error += static_cast<double>(cm.query(flow.first)) - flow.second;
+            }
+            r.detector = name;
+            r.mem_size = mem_size;
+            r.bytes = cm.size();
+            r.mean_error = truth.empty() ? 0 : error / truth.size();
+            results.push_back(r);
+        }
+        volatile uint32_t keep = sink;
+        (void)keep;
+    }
+
+    template <typename counter_t>
+    void benchCMSketchWidth(const Options &opt, const std::vector<core::Record> &records, const FlowCounts &truth,
+                            const char *label, long mem_size, std::vector<Result> &results) {
+        using cm_t = sketch::CMSketch<hash::AwareHash, counter_t>;
+        int width = static_cast<int>(mem_size / (CM_DEPTH * cm_t::bytesPerCounter()));
+        for (bool conservative : {false, true}) {
+            cm_t cm(width, CM_DEPTH, conservative);
+            std::string name = std::string("CMSketch-") + label + (conservative ? "-cu" : "");
+            benchCMSketch(opt, records, truth, name, mem_size, cm, results);
+        }
+    }
+
+    void runDetector(const Options &opt, const DetectorConfig &base, const std::vector<core::Record> &records,
+                     const std::string &name, long mem_size, std::vector<Result> &results) {
+        DetectorConfig c = base;
+        c.mem_size = mem_size;
+        auto bench = [&](auto &sketch) { benchDetector(opt, records, name, mem_size, sketch, results); };
+
+        if (withDetector(name, c, bench)) {
+            return;
+        }
+        if (name == "CMSketch") {
+            FlowCounts truth;
+            for (const auto &record : records) {
+                ++truth[record.flowkey_];
+            }
+            NestedCMSketch<hash::AwareHash> nested(static_cast<int>(mem_size / (CM_DEPTH * sizeof(uint32_t))), CM_DEPTH);
+            benchCMSketch(opt, records, truth, "CMSketch-nested", mem_size, nested, results);
+            benchCMSketchWidth<uint32_t>(opt, records, truth, "u32", mem_size, results);
+            benchCMSketchWidth<uint16_t>(opt, records, truth, "u16", mem_size, results);
+            benchCMSketchWidth<uint8_t>(opt, records, truth, "u8", mem_size, results);
+        } else if (name == "BloomFilter") {
+            int num_hash = base.fd.gnum_hash > 0 ? base.fd.gnum_hash : 4;
+            sketch::BloomFilter<hash::AwareHash> bf(static_cast<int>(std::min<long>(mem_size * 8, 1L << 30)), num_hash);
+            for (bool cold : {false, true}) {
+                Result r = measure(opt, records, cold, [&]() { bf.clear(); },
+                                   [&](const core::Record &record) {
+                                       if (!bf.query(record.flowkey_)) {
+                                           bf.insert(record.flowkey_);
+                                       }
+                                   });
+                r.detector = name;
+                r.mem_size = mem_size;
+                r.bytes = bf.size();
+                results.push_back(r);
+            }
+        } else {
+            fprintf(stderr, "Unknown detector '%s'\n", name.c_str());
+        }
+    }
+
+    void printCounter(int64_t v, bool json) {
+        if (v < 0) {
+            fputs(json ? "null" : "", stdout);
+        } else {
+            printf("%lld", static_cast<long long>(v));
+        }
+    }
+
+    void printError(double v, bool json) {
+        if (v < 0) {
+            fputs(json ? "null" : "", stdout);
+        } else {
+            printf("%.3f", v);
+        }
+    }
+
+    void printResults(const std::vector<Result> &results, const std::string &format) {
+        bool json = format == "json";
+        if (json) {
+            printf("[\n");
+        } else {
+            printf("detector,mem_size,bytes,state,packets,ns_per_packet,mpps");
+            for (int e = 0; e < PerfCounters::NUM_EVENTS; ++e) {
+                printf(",%s", PerfCounters::name(e));
+            }
+            printf(",mean_error\n");
+        }
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result &r = results[i];
+            double mpps = r.ns_per_packet > 0 ? 1e3 / r.ns_per_packet : 0;
+            if (json) {
+                printf("  {\"detector\": \"%s\", \"mem_size\": %ld, \"bytes\": %zu, \"state\": \"%s\", "
+                       "\"packets\": %zu, \"ns_per_packet\": %.3f, \"mpps\": %.3f",
+                       r.detector.c_str(), r.mem_size, r.bytes, r.state, r.packets, r.ns_per_packet, mpps);
+                for (int e = 0; e < PerfCounters::NUM_EVENTS; ++e) {
+                    printf(", \"%s\": ", PerfCounters::name(e));
+                    printCounter(r.counters[e], true);
+                }
+                printf(", \"mean_error\": ");
+                printError(r.mean_error, true);
+                printf("}%s\n", i + 1 < results.size() ? "," : "");
+            } else {
+                printf("%s,%ld,%zu,%s,%zu,%.3f,%.3f", r.detector.c_str(), r.mem_size, r.bytes, r.state,
+                       r.packets, r.ns_per_packet, mpps);
+                for (int e = 0; e < PerfCounters::NUM_EVENTS; ++e) {
+                    printf(",");
+                    printCounter(r.counters[e], false);
+                }
+                printf(",");
+                printError(r.mean_error, false);
+                printf("\n");
+            }
+        }
+        if (json) {
+            printf("]\n");
+        }
+    }
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <settings.conf> [--format json|csv] [--mem a,b,...] [--detectors a,b,...] "
+                        "[--reps N] [--packets N] [--synthetic-flows N] [--evict-mb N]\n", argv[0]);
+        return 1;
+    }
+    auto config = core::load_settings(argv[1]);
+    if (!config || config->ParseError() < 0) {
+        fprintf(stderr, "Can't load '%s'\n", argv[1]);
+        return 1;
+    }
+
+    Options opt;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--format") {
+            opt.format = value;
+        } else if (flag == "--mem") {
+            opt.mem_sizes.clear();
+            for (const std::string &mem : core::split_list(value)) {
+                opt.mem_sizes.push_back(std::stol(mem));
+            }
+        } else if (flag == "--detectors") {
+            opt.detectors = core::split_list(value);
+        } else if (flag == "--reps") {
+            opt.reps = std::max(1, std::atoi(value.c_str()));
+        } else if (flag == "--packets") {
+            opt.packets = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (flag == "--synthetic-flows") {
+            opt.synthetic_flows = std::max(1, std::atoi(value.c_str()));
+        } else if (flag == "--evict-mb") {
+            opt.evict_bytes = std::strtoull(value.c_str(), nullptr, 10) << 20;
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", flag.c_str());
+            return 1;
+        }
+    }
+    if (opt.format != "json" && opt.format != "csv") {
+        fprintf(stderr, "--format must be json or csv\n");
+        return 1;
+    }
+
+    std::vector<core::Record> records;
+    std::string data_file = config->Get("general", "data_file", "");
+    FILE *probe = data_file.empty() ? nullptr : fopen(data_file.c_str(), "rb");
+    if (probe) {
+        fclose(probe);
+        // load_records reports progress on stdout; keep stdout for results.
+        fflush(stdout);
+        int saved_stdout = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        records = core::load_records(data_file);
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        if (opt.packets > 0 && opt.packets < records.size()) {
+            records.resize(opt.packets);
+        }
+    } else {
+        size_t packets = opt.packets > 0 ? opt.packets : 2000000;
+        fprintf(stderr, "'%s' not found, using a synthetic trace of %zu packets over %d flows\n",
+                data_file.c_str(), packets, opt.synthetic_flows);
+        records = syntheticTrace(packets, opt.synthetic_flows);
+    }
+    if (records.empty()) {
+        fprintf(stderr, "Empty trace\n");
+        return 1;
+    }
+
+    {
+        PerfCounters perf;
+        if (!perf.available()) {
+            fprintf(stderr, "perf_event_open unavailable (check kernel.perf_event_paranoid); counters will be null\n");
+        }
+    }
+
+    DetectorConfig base = DetectorConfig::load(config);
+    std::vector<Result> results;
+    for (const auto &name : opt.detectors) {
+        for (long mem_size : opt.mem_sizes) {
+            fprintf(stderr, "%s mem_size=%ld\n", name.c_str(), mem_size);
+            runDetector(opt, base, records, name, mem_size, results);
+        }
+    }
+    printResults(results, opt.format);
+    return 0;
+}
@@ -1,6 +1,7 @@
 #ifndef DETECTOR_ABSTRACTDETECTOR_HH
 #define DETECTOR_ABSTRACTDETECTOR_HH
 
+#include "utils/core.hh"
 #include "utils/flowkey.hh"
 #include <string>
 #include <cstdint>
@@ -17,6 +18,15 @@ public:
 
     virtual uint64_t update(const FlowKey<13> &flowkey, uint64_t timestamp) = 0;
 
+    // Same as update() on each of the n records in order. The sketches
+    // override it with their own update() inlined, so a caller holding an
+    // AbstractDetector* pays one indirect call per batch, not per packet.
+    virtual void updateBatch(const core::Record *records, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            update(records[i].flowkey_, records[i].timestamp_);
+        }
+    }
+
     virtual auto clear() -> void = 0;
 };
 
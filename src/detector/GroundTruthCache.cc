@@ -0,0 +1,163 @@
+#include "detector/GroundTruthCache.hh"
+#include "utils/hash.hh"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    const char CACHE_MAGIC[8] = {'J', 'S', 'G', 'T', 'C', '0', '0', '1'};
+
+    struct CacheHeader {
+        char magic[8];
+        GroundTruthCache::Key key;
+        uint64_t flow_count;
+        uint64_t num_events;
+    };
+
+    struct CachedEvent {
+        uint64_t old_ifpd;
+        uint64_t new_ifpd;
+        uint64_t timestamp;
+        uint8_t flowkey[13];
+        uint8_t pad[3];
+    };
+    static_assert(sizeof(CachedEvent) == 40, "CachedEvent layout changed");
+
+    inline uint64_t mix(uint64_t h, uint64_t v) {
+        h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+        h *= 0xD6E8FEB86659FD93ULL;
+        return h ^ (h >> 32);
+    }
+
+    inline uint64_t bits(double v) {
+        uint64_t u;
+        std::memcpy(&u, &v, sizeof(u));
+        return u;
+    }
+
+} // namespace
+
+bool GroundTruthCache::Key::operator==(const Key &other) const {
+    return trace_digest == other.trace_digest && num_records == other.num_records &&
+           bits(jitter_factor) == bits(other.jitter_factor) &&
+           min_absolute_jitter_thres == other.min_absolute_jitter_thres &&
+           max_ifpd_diff == other.max_ifpd_diff && jitter_detection_mode == other.jitter_detection_mode &&
+           frequency_threshold == other.frequency_threshold;
+}
+
+uint64_t GroundTruthCache::Key::hash() const {
+    uint64_t h = mix(trace_digest, num_records);
+    h = mix(h, bits(jitter_factor));
+    h = mix(h, min_absolute_jitter_thres);
+    h = mix(h, max_ifpd_diff);
+    h = mix(h, static_cast<uint32_t>(jitter_detection_mode));
+    return mix(h, static_cast<uint32_t>(frequency_threshold));
+}
+
+uint64_t GroundTruthCache::traceDigestAdd(uint64_t digest, const FlowKey<13> &flowkey, uint64_t timestamp) {
+    return mix(digest, hash::FlowKeyHash()(flowkey) ^ timestamp);
+}
+
+uint64_t GroundTruthCache::traceDigest(const std::vector<core::Record> &records) {
+    uint64_t h = traceDigestBegin(records.size());
+    for (const auto &record : records) {
+        h = traceDigestAdd(h, record.flowkey_, record.timestamp_);
+    }
+    return h;
+}
+
+std::string GroundTruthCache::path(const Key &key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "gt_%016llx.bin", static_cast<unsigned long long>(key.hash()));
+    return dir_ + "/" + name;
+}
+
+bool GroundTruthCache::load(const Key &key, std::vector<Event> &events, uint64_t &flow_count) const {
+    return enabled() && readFile(path(key), key, events, flow_count);
+}
+
+bool GroundTruthCache::readFile(const std::string &file, const Key &key, std::vector<Event> &events,
+                                uint64_t &flow_count) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    bool valid = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 && header.key == key &&
+                 size == sizeof(CacheHeader) + header.num_events * sizeof(CachedEvent);
+    if (valid) {
+        const CachedEvent *cached = reinterpret_cast<const CachedEvent *>(static_cast<const char *>(map) + sizeof(CacheHeader));
+        events.clear();
+        events.reserve(header.num_events);
+        for (uint64_t i = 0; i < header.num_events; ++i) {
+            events.emplace_back(FlowKey<13>(cached[i].flowkey), cached[i].old_ifpd, cached[i].new_ifpd, cached[i].timestamp);
+        }
+        flow_count = header.flow_count;
+    }
+    ::munmap(map, size);
+    return valid;
+}
+
+bool GroundTruthCache::store(const Key &key, const std::vector<Event> &events, uint64_t flow_count) const {
+    if (!enabled()) {
+        return false;
+    }
+    if (::mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        printf("Ground-truth cache: can't create '%s': %s\n", dir_.c_str(), strerror(errno));
+        return false;
+    }
+    return writeFile(path(key), key, events, flow_count);
+}
+
+bool GroundTruthCache::writeFile(const std::string &file, const Key &key, const std::vector<Event> &events,
+                                 uint64_t flow_count) {
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.key = key;
+    header.flow_count = flow_count;
+    header.num_events = events.size();
+
+    std::vector<CachedEvent> cached(events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        std::memset(&cached[i], 0, sizeof(CachedEvent));
+        std::memcpy(cached[i].flowkey, std::get<0>(events[i]).cKey(), 13);
+        cached[i].old_ifpd = std::get<1>(events[i]);
+        cached[i].new_ifpd = std::get<2>(events[i]);
+        cached[i].timestamp = std::get<3>(events[i]);
+    }
+
+    std::string tmp = file + ".tmp." + std::to_string(::getpid());
+    FILE *out = fopen(tmp.c_str(), "wb");
+    if (!out) {
+        printf("Ground-truth cache: can't write '%s'\n", tmp.c_str());
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              (cached.empty() || fwrite(cached.data(), sizeof(CachedEvent), cached.size(), out) == cached.size());
+    ok = (fclose(out) == 0) && ok;
+    if (!ok || ::rename(tmp.c_str(), file.c_str()) != 0) {
+        printf("Ground-truth cache: can't write '%s'\n", file.c_str());
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
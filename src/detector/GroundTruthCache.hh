@@ -0,0 +1,67 @@
+#ifndef DETECTOR_GROUNDTRUTHCACHE_HH
+#define DETECTOR_GROUNDTRUTHCACHE_HH
+
+#include "utils/flowkey.hh"
+#include "utils/core.hh"
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// On-disk cache of ground-truth jitter events.
+//
+// An entry is keyed by a content digest of the trace (every record's flow
+// key and timestamp, as loaded) plus the detection parameters, and lives
+// in <dir>/gt_<key>.bin. The full key is also stored in the file header and
+// checked on load, so a stale or foreign file is recomputed, never
+// trusted. Files are written to a temporary name and renamed into place,
+// so concurrent sweep runs never see a half-written entry. An empty dir
+// disables the cache.
+class GroundTruthCache {
+public:
+    using Event = std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>;
+
+    struct Key {
+        uint64_t trace_digest;
+        uint64_t num_records;
+        double jitter_factor;
+        uint64_t min_absolute_jitter_thres;
+        uint64_t max_ifpd_diff;
+        int32_t jitter_detection_mode;
+        int32_t frequency_threshold;
+
+        bool operator==(const Key &other) const;
+        uint64_t hash() const;
+    };
+
+    explicit GroundTruthCache(std::string dir) : dir_(std::move(dir)) {}
+
+    bool enabled() const { return !dir_.empty(); }
+
+    // 64-bit digest of the trace contents that affect ground truth.
+    static uint64_t traceDigest(const std::vector<core::Record> &records);
+
+    // The same digest built one record at a time, in trace order, for
+    // writers that never hold the whole trace.
+    static uint64_t traceDigestBegin(uint64_t num_records) { return num_records; }
+    static uint64_t traceDigestAdd(uint64_t digest, const FlowKey<13> &flowkey, uint64_t timestamp);
+
+    std::string path(const Key &key) const;
+
+    // Maps the entry for key and copies its events out. Returns false when
+    // there is no valid entry.
+    bool load(const Key &key, std::vector<Event> &events, uint64_t &flow_count) const;
+
+    bool store(const Key &key, const std::vector<Event> &events, uint64_t flow_count) const;
+
+    // The entry format at an explicit path, for label files written next
+    // to synthetic traces.
+    static bool readFile(const std::string &file, const Key &key, std::vector<Event> &events, uint64_t &flow_count);
+    static bool writeFile(const std::string &file, const Key &key, const std::vector<Event> &events,
+                          uint64_t flow_count);
+
+private:
+    std::string dir_;
+};
+
+#endif // DETECTOR_GROUNDTRUTHCACHE_HH
@@ -3,42 +3,73 @@
 
 #include "utils/flowkey.hh"
 #include "utils/core.hh"
-#include <map>
+#include "utils/hash.hh"
+#include "utils/FlatHashMap.hh"
+#include "detector/GroundTruthCache.hh"
+#include "detector/SpilledGroundTruth.hh"
+#include <algorithm>
 #include <cstdint>
+#include <memory>
+#include <thread>
 #include <vector>
 #include <tuple>
+#include <string>
+
+// How GroundTruthDetector::run() evaluates a trace.
+struct GroundTruthOptions {
+    unsigned num_threads = 0;      // 0 = all cores
+    std::string cache_dir;         // on-disk event cache, empty = off
+    std::string spill_dir;         // flow-state spilling when set
+    int spill_partitions = 64;
+    std::string labels_file;       // events written by tracegen, used instead of computing
+
+    // From the truth_* keys of [general].
+    static GroundTruthOptions load(std::shared_ptr<INIReader> config) {
+        GroundTruthOptions options;
+        options.num_threads = config->GetInteger("general", "truth_threads", 0);
+        options.cache_dir = config->Get("general", "truth_cache_dir", "");
+        options.spill_dir = config->Get("general", "truth_spill_dir", "");
+        options.spill_partitions = config->GetInteger("general", "truth_spill_partitions", 64);
+        options.labels_file = config->Get("general", "truth_labels", "");
+        return options;
+    }
+};
+
 class GroundTruthDetector {
+public:
+    using Event = std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>;
+
 private:
-    std::map<FlowKey<13>, uint64_t> flow_map;
-    std::map<FlowKey<13>, uint64_t> last_ifpd_map;
-    std::map<FlowKey<13>, int> flow_counts;
-    std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>> abnormal_events;
+    // All exact per-flow state, looked up once per packet.
+    struct FlowState {
+        uint64_t last_timestamp = 0;
+        uint64_t last_ifpd = 0;
+        int count = 0;
+        bool has_ifpd = false;
+    };
+    using FlowTable = core::FlatHashMap<FlowKey<13>, FlowState, hash::FlowKeyHash>;
+
+    FlowTable flows_;
+    size_t flow_count_ = 0;
+    std::vector<Event> abnormal_events;
     double jitter_factor_;
     uint64_t min_absolute_jitter_thres_;
     uint64_t max_ifpd_diff_;
     int jitter_detection_mode_; // 0: deceleration, 1: acceleration, 2: both
     int frequency_threshold_;
 
-public:
-    GroundTruthDetector(double jitter_factor, uint64_t min_absolute_jitter_thres, uint64_t max_ifpd_diff, int jitter_detection_mode, int frequency_threshold)
-            : jitter_factor_(jitter_factor), min_absolute_jitter_thres_(min_absolute_jitter_thres), max_ifpd_diff_(max_ifpd_diff), jitter_detection_mode_(jitter_detection_mode), frequency_threshold_(frequency_threshold) {}
-
-    uint64_t update(const core::Record& record) {
+    uint64_t process(FlowTable &flows, const core::Record &record, std::vector<Event> &events) const {
         uint64_t real_delay = 0;
-        auto iter = flow_map.find(record.flowkey_);
-        if (iter == flow_map.end()) {
-            flow_map.emplace(record.flowkey_, record.timestamp_);
-            real_delay = 0;
-        } else {
-            real_delay = record.timestamp_ - iter->second;
-            iter->second = record.timestamp_;
+        auto slot = flows.findOrInsert(record.flowkey_);
+        FlowState &state = *slot.first;
+        if (!slot.second) {
+            real_delay = record.timestamp_ - state.last_timestamp;
         }
+        state.last_timestamp = record.timestamp_;
 
-        flow_counts[record.flowkey_]++;
-        if (flow_counts[record.flowkey_] >= frequency_threshold_) {
-            auto ifpd_iter = last_ifpd_map.find(record.flowkey_);
-            if (ifpd_iter != last_ifpd_map.end()) {
-                uint64_t old_ifpd = ifpd_iter->second;
+        if (++state.count >= frequency_threshold_) {
+            if (state.has_ifpd) {
+                uint64_t old_ifpd = state.last_ifpd;
                 uint64_t diff = std::abs((int64_t)real_delay - (int64_t)old_ifpd);
 
                 bool deceleration_jitter = (old_ifpd > 0 && real_delay > jitter_factor_ * old_ifpd);
@@ -55,29 +86,154 @@ public:
 
 
                 if (report && diff > min_absolute_jitter_thres_ && diff < max_ifpd_diff_) {
-                    abnormal_events.emplace_back(record.flowkey_, old_ifpd, real_delay, record.timestamp_);
+                    events.emplace_back(record.flowkey_, old_ifpd, real_delay, record.timestamp_);
                 }
             }
-            last_ifpd_map[record.flowkey_] = real_delay;
+            state.last_ifpd = real_delay;
+            state.has_ifpd = true;
         }
 
         return real_delay;
     }
 
+public:
+    GroundTruthDetector(double jitter_factor, uint64_t min_absolute_jitter_thres, uint64_t max_ifpd_diff, int jitter_detection_mode, int frequency_threshold)
+            : jitter_factor_(jitter_factor), min_absolute_jitter_thres_(min_absolute_jitter_thres), max_ifpd_diff_(max_ifpd_diff), jitter_detection_mode_(jitter_detection_mode), frequency_threshold_(frequency_threshold) {}
+
+    uint64_t update(const core::Record& record) {
+        uint64_t real_delay = process(flows_, record, abnormal_events);
+        flow_count_ = flows_.size();
+        return real_delay;
+    }
+
+    // Runs the whole trace. With num_threads > 1 (0 = all cores) the flows
+    // are partitioned by hash across threads; each thread scans the trace
+    // and keeps state only for its own flows, since a flow's ground truth
+    // depends on nothing else. Events come out in the same (trace) order
+    // as the serial update() loop produces.
+    void run(const std::vector<core::Record> &records, unsigned num_threads = 0) {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (num_threads == 1 || records.size() < 100000) {
+            for (const auto &record : records) {
+                update(record);
+            }
+            return;
+        }
+
+        std::vector<std::vector<std::pair<size_t, Event>>> events(num_threads);
+        std::vector<size_t> flow_counts(num_threads, 0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < num_threads; ++t) {
+            workers.emplace_back([&, t]() {
+                FlowTable flows;
+                std::vector<Event> local;
+                for (size_t i = 0; i < records.size(); ++i) {
+                    if (hash::FlowKeyHash::partition(records[i].flowkey_, num_threads) != t) {
+                        continue;
+                    }
+                    process(flows, records[i], local);
+                    if (!local.empty()) {
+                        events[t].emplace_back(i, local.back());
+                        local.clear();
+                    }
+                }
+                flow_counts[t] = flows.size();
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        std::vector<std::pair<size_t, Event>> merged;
+        for (unsigned t = 0; t < num_threads; ++t) {
+            merged.insert(merged.end(), events[t].begin(), events[t].end());
+            flow_count_ += flow_counts[t];
+        }
+        std::sort(merged.begin(), merged.end(),
+                  [](const std::pair<size_t, Event> &a, const std::pair<size_t, Event> &b) { return a.first < b.first; });
+        abnormal_events.reserve(abnormal_events.size() + merged.size());
+        for (auto &event : merged) {
+            abnormal_events.push_back(event.second);
+        }
+    }
+
+    // Exact ground truth with bounded flow state: flows are spilled to
+    // partition files under spill_dir and evaluated partition by partition.
+    // The records themselves are still the in-memory trace; this only helps
+    // when the per-flow state, not the trace, is what does not fit.
+    bool runSpilled(const std::vector<core::Record> &records, const std::string &spill_dir,
+                    int num_partitions, unsigned num_threads = 0) {
+        SpilledGroundTruth spilled(jitter_factor_, min_absolute_jitter_thres_, max_ifpd_diff_,
+                                   jitter_detection_mode_, frequency_threshold_,
+                                   spill_dir, num_partitions, num_threads);
+        for (const auto &record : records) {
+            if (!spilled.add(record)) {
+                return false;
+            }
+        }
+        return spilled.finish(abnormal_events, flow_count_);
+    }
+
+    // run() as configured by options: takes the events from the label file
+    // or the cache if either holds them for this trace and these
+    // parameters, otherwise computes them (in memory or with spilled flow state) and
+    // stores them in the cache. Returns true when nothing was computed.
+    bool run(const std::vector<core::Record> &records, const GroundTruthOptions &options) {
+        GroundTruthCache cache(options.cache_dir);
+        GroundTruthCache::Key key;
+        clear();
+        if (cache.enabled() || !options.labels_file.empty()) {
+            key.trace_digest = GroundTruthCache::traceDigest(records);
+            key.num_records = records.size();
+            key.jitter_factor = jitter_factor_;
+            key.min_absolute_jitter_thres = min_absolute_jitter_thres_;
+            key.max_ifpd_diff = max_ifpd_diff_;
+            key.jitter_detection_mode = jitter_detection_mode_;
+            key.frequency_threshold = frequency_threshold_;
+
+            uint64_t flow_count = 0;
+            if (!options.labels_file.empty()) {
+                if (GroundTruthCache::readFile(options.labels_file, key, abnormal_events, flow_count)) {
+                    flow_count_ = flow_count;
+                    return true;
+                }
+                printf("Labels '%s' are not for this trace and these parameters, computing ground truth\n",
+                       options.labels_file.c_str());
+            }
+            if (cache.load(key, abnormal_events, flow_count)) {
+                flow_count_ = flow_count;
+                return true;
+            }
+        }
+
+        if (options.spill_dir.empty()) {
+            run(records, options.num_threads);
+        } else if (!runSpilled(records, options.spill_dir, options.spill_partitions, options.num_threads)) {
+            printf("Spilled ground truth failed, falling back to in-memory evaluation\n");
+            clear();
+            run(records, options.num_threads);
+        }
+        if (cache.enabled()) {
+            cache.store(key, abnormal_events, flow_count_);
+        }
+        return false;
+    }
+
     size_t get_flow_count() const {
-        return flow_map.size();
+        return flow_count_;
     }
 
-    const std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>>& getAbnormalEvents() const {
+    const std::vector<Event>& getAbnormalEvents() const {
         return abnormal_events;
     }
 
     void clear() {
-        flow_map.clear();
-        last_ifpd_map.clear();
+        flows_.clear();
+        flow_count_ = 0;
         abnormal_events.clear();
-        flow_counts.clear();
     }
 };
 
-#endif // DETECTOR_GROUNDTRUTHDETECTOR_HH
\ No newline at end of file
+#endif // DETECTOR_GROUNDTRUTHDETECTOR_HH
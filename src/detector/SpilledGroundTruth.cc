@@ -0,0 +1,171 @@
+#include "detector/SpilledGroundTruth.hh"
+#include "detector/GroundTruthDetector.hh"
+#include "utils/hash.hh"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static_assert(sizeof(SpilledGroundTruth::SpillRecord) == 32, "SpillRecord layout changed");
+
+SpilledGroundTruth::SpilledGroundTruth(double jitter_factor, uint64_t min_absolute_jitter_thres, uint64_t max_ifpd_diff,
+                                         int jitter_detection_mode, int frequency_threshold,
+                                         std::string spill_dir, int num_partitions, unsigned num_threads)
+        : jitter_factor_(jitter_factor), min_absolute_jitter_thres_(min_absolute_jitter_thres), max_ifpd_diff_(max_ifpd_diff),
+          jitter_detection_mode_(jitter_detection_mode), frequency_threshold_(frequency_threshold),
+          spill_dir_(std::move(spill_dir)),
+          num_threads_(num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency())),
+          partitions_(std::max(1, num_partitions)) {
+    static std::atomic<unsigned> instance{0};
+    if (::mkdir(spill_dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        printf("Spilled ground truth: can't create '%s': %s\n", spill_dir_.c_str(), strerror(errno));
+        ok_ = false;
+    }
+    std::string prefix = spill_dir_ + "/gt_spill_" + std::to_string(::getpid()) + "_" + std::to_string(instance++) + "_";
+    for (size_t p = 0; p < partitions_.size(); ++p) {
+        partitions_[p].path = prefix + std::to_string(p) + ".bin";
+        partitions_[p].buffer.reserve(BUFFER_RECORDS);
+    }
+}
+
+SpilledGroundTruth::~SpilledGroundTruth() {
+    for (auto &partition : partitions_) {
+        if (partition.file) {
+            fclose(partition.file);
+            ::unlink(partition.path.c_str());
+        }
+    }
+}
+
+bool SpilledGroundTruth::flush(Partition &partition) {
+    if (partition.buffer.empty() || !ok_) {
+        partition.buffer.clear();
+        return ok_;
+    }
+    if (!partition.file) {
+        partition.file = fopen(partition.path.c_str(), "wb");
+        if (!partition.file) {
+            printf("Spilled ground truth: can't write '%s'\n", partition.path.c_str());
+            ok_ = false;
+            return false;
+        }
+    }
+    if (fwrite(partition.buffer.data(), sizeof(SpillRecord), partition.buffer.size(), partition.file) != partition.buffer.size()) {
+        printf("Spilled ground truth: short write to '%s'\n", partition.path.c_str());
+        ok_ = false;
+    }
+    partition.buffer.clear();
+    return ok_;
+}
+
+bool SpilledGroundTruth::add(const core::Record &record) {
+    Partition &partition = partitions_[hash::FlowKeyHash::partition(record.flowkey_, partitions_.size())];
+    SpillRecord spill;
+    spill.seq = seq_++;
+    spill.timestamp = record.timestamp_;
+    std::memcpy(spill.flowkey, record.flowkey_.cKey(), 13);
+    std::memset(spill.pad, 0, sizeof(spill.pad));
+    partition.buffer.push_back(spill);
+    if (partition.buffer.size() >= BUFFER_RECORDS) {
+        return flush(partition);
+    }
+    return ok_;
+}
+
+bool SpilledGroundTruth::finish(std::vector<Event> &events, size_t &flow_count) {
+    for (auto &partition : partitions_) {
+        flush(partition);
+        if (partition.file && fclose(partition.file) != 0) {
+            ok_ = false;
+        }
+        partition.file = nullptr;
+    }
+    if (!ok_) {
+        return false;
+    }
+
+    // Events of each partition, with the trace position that raised them.
+    struct PartitionResult {
+        std::vector<Event> events;
+        std::vector<uint64_t> seqs;
+        size_t flows = 0;
+    };
+    std::vector<PartitionResult> results(partitions_.size());
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]() {
+        std::vector<SpillRecord> chunk(BUFFER_RECORDS);
+        for (size_t p = next++; p < partitions_.size(); p = next++) {
+            FILE *in = fopen(partitions_[p].path.c_str(), "rb");
+            if (!in) {
+                continue; // no packet hashed here
+            }
+            GroundTruthDetector detector(jitter_factor_, min_absolute_jitter_thres_, max_ifpd_diff_,
+                                         jitter_detection_mode_, frequency_threshold_);
+            PartitionResult &result = results[p];
+            core::Record record;
+            size_t n;
+            while ((n = fread(chunk.data(), sizeof(SpillRecord), chunk.size(), in)) > 0) {
+                for (size_t i = 0; i < n; ++i) {
+                    record.flowkey_ = FlowKey<13>(chunk[i].flowkey);
+                    record.timestamp_ = chunk[i].timestamp;
+                    size_t before = detector.getAbnormalEvents().size();
+                    detector.update(record);
+                    if (detector.getAbnormalEvents().size() != before) {
+                        result.seqs.push_back(chunk[i].seq);
+                    }
+                }
+            }
+            if (ferror(in)) {
+                failed = true;
+            }
+            fclose(in);
+            ::unlink(partitions_[p].path.c_str());
+            result.events = detector.getAbnormalEvents();
+            result.flows = detector.get_flow_count();
+        }
+    };
+    std::vector<std::thread> workers;
+    unsigned num_workers = std::min<unsigned>(num_threads_, partitions_.size());
+    for (unsigned t = 1; t < num_workers; ++t) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &w : workers) {
+        w.join();
+    }
+    if (failed) {
+        printf("Spilled ground truth: read error on a spill file\n");
+        return false;
+    }
+
+    // k-way merge by (timestamp, trace position).
+    using Head = std::tuple<uint64_t, uint64_t, size_t, size_t>; // ts, seq, partition, index
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    size_t total = 0;
+    for (size_t p = 0; p < results.size(); ++p) {
+        flow_count += results[p].flows;
+        total += results[p].events.size();
+        if (!results[p].events.empty()) {
+            heads.emplace(std::get<3>(results[p].events[0]), results[p].seqs[0], p, 0);
+        }
+    }
+    events.reserve(events.size() + total);
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        size_t p = std::get<2>(head);
+        size_t i = std::get<3>(head);
+        events.push_back(results[p].events[i]);
+        if (++i < results[p].events.size()) {
+            heads.emplace(std::get<3>(results[p].events[i]), results[p].seqs[i], p, i);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef DETECTOR_SPILLEDGROUNDTRUTH_HH
+#define DETECTOR_SPILLEDGROUNDTRUTH_HH
+
+#include "utils/flowkey.hh"
+#include "utils/core.hh"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Exact ground truth for traces whose per-flow state does not fit in RAM.
+// Only that state is spilled: the records are fed from the trace the
+// experiments already hold in memory (key-shuffled by load_records), so a
+// trace that does not fit in RAM still cannot be evaluated.
+//
+// add() hash-partitions the record stream by flow into num_partitions spill
+// files under spill_dir, so every packet of a flow lands in the same file
+// and only a small write buffer per partition stays in memory. finish()
+// runs an ordinary GroundTruthDetector over each partition on num_threads
+// workers, holding one partition's flow state per worker at a time. The
+// per-partition events are then k-way merged by timestamp (ties by trace
+// position) into the event format jitterTest expects. Spill files are
+// removed as soon as their partition is processed.
+class SpilledGroundTruth {
+public:
+    using Event = std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>;
+
+    SpilledGroundTruth(double jitter_factor, uint64_t min_absolute_jitter_thres, uint64_t max_ifpd_diff,
+                        int jitter_detection_mode, int frequency_threshold,
+                        std::string spill_dir, int num_partitions, unsigned num_threads = 0);
+    ~SpilledGroundTruth();
+    SpilledGroundTruth(const SpilledGroundTruth &) = delete;
+    SpilledGroundTruth &operator=(const SpilledGroundTruth &) = delete;
+
+    // Returns false once a spill file could not be written.
+    bool add(const core::Record &record);
+
+    // Processes every partition and appends the merged events. Returns
+    // false if a spill file failed; events are then incomplete.
+    bool finish(std::vector<Event> &events, size_t &flow_count);
+
+    struct SpillRecord {
+        uint64_t seq;
+        uint64_t timestamp;
+        uint8_t flowkey[13];
+        uint8_t pad[3];
+    };
+
+private:
+    static constexpr size_t BUFFER_RECORDS = 4096;
+
+    struct Partition {
+        std::string path;
+        FILE *file = nullptr;
+        std::vector<SpillRecord> buffer;
+    };
+
+    bool flush(Partition &partition);
+
+    double jitter_factor_;
+    uint64_t min_absolute_jitter_thres_;
+    uint64_t max_ifpd_diff_;
+    int jitter_detection_mode_;
+    int frequency_threshold_;
+    std::string spill_dir_;
+    unsigned num_threads_;
+    uint64_t seq_ = 0;
+    bool ok_ = true;
+    std::vector<Partition> partitions_;
+};
+
+#endif // DETECTOR_SPILLEDGROUNDTRUTH_HH
@@ -0,0 +1,179 @@
+#ifndef EXPERIMENT_BUFFERPOOL_HH
+#define EXPERIMENT_BUFFERPOOL_HH
+
+#include "utils/FlatHashMap.hh"
+#include "utils/flowkey.hh"
+#include "utils/hash.hh"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed set of per-flow packet buffers for the jitter control experiment.
+//
+// Slots are handed out from a free list and found through a flat flow
+// index sized for the whole pool, so neither ever rehashes or scans.
+// Timestamps live in fixed-size chunks carved from one shared arena; a
+// buffer is a linked run of chunks, and released chunks go back on a free
+// list for the next buffer. The arena only grows when more chunks are in
+// use at once than ever before, so once it has reached its high-water mark
+// buffering allocates nothing.
+//
+// Active buffers are also linked in order of last arrival, oldest first.
+// Packets arrive in timestamp order and every append moves its buffer to
+// the back, so with one timeout for all buffers the list is sorted by
+// expiry deadline and the buffers due to expire are always at the front.
+class BufferPool {
+public:
+    static constexpr size_t CHUNK_PACKETS = 32;
+
+    struct Slot {
+        FlowKey<13> flowkey;
+        uint64_t last_arrival_time = 0;
+        size_t count = 0;
+        int first_chunk = -1;
+        int last_chunk = -1;
+        bool is_active = false;
+        int prev = -1;      // expiry order
+        int next = -1;
+    };
+
+    explicit BufferPool(int max_buffers)
+            : slots_(max_buffers > 0 ? max_buffers : 0), index_(slots_.size()) {
+        free_slots_.reserve(slots_.size());
+        for (size_t i = slots_.size(); i-- > 0;) {
+            free_slots_.push_back(static_cast<int>(i));
+        }
+        arena_.reserve(slots_.size() * CHUNK_PACKETS);
+        chunk_next_.reserve(slots_.size());
+    }
+
+    size_t capacity() const { return slots_.size(); }
+    size_t active() const { return slots_.size() - free_slots_.size(); }
+    bool full() const { return free_slots_.empty(); }
+
+    const Slot &slot(int i) const { return slots_[i]; }
+
+    // Buffer holding the flow, or -1.
+    int find(const FlowKey<13> &flowkey) const {
+        const int *i = index_.find(flowkey);
+        return i ? *i : -1;
+    }
+
+    // Opens a buffer for the flow holding its first packet; -1 when full.
+    int acquire(const FlowKey<13> &flowkey, uint64_t timestamp) {
+        if (free_slots_.empty()) {
+            return -1;
+        }
+        int i = free_slots_.back();
+        free_slots_.pop_back();
+        Slot &s = slots_[i];
+        s.flowkey = flowkey;
+        s.is_active = true;
+        index_[flowkey] = i;
+        pushBack(i);
+        append(i, timestamp);
+        return i;
+    }
+
+    void append(int i, uint64_t timestamp) {
+        Slot &s = slots_[i];
+        if (s.count % CHUNK_PACKETS == 0) {
+            int chunk = newChunk();
+            (s.last_chunk != -1 ? chunk_next_[s.last_chunk] : s.first_chunk) = chunk;
+            s.last_chunk = chunk;
+        }
+        arena_[s.last_chunk * CHUNK_PACKETS + s.count % CHUNK_PACKETS] = timestamp;
+        ++s.count;
+        s.last_arrival_time = timestamp;
+        if (i != tail_) {
+            unlink(i);
+            pushBack(i);
+        }
+    }
+
+    // Active buffer with the oldest last arrival, or -1.
+    int oldest() const { return head_; }
+
+    // Appends the buffer's timestamps to out, in arrival order.
+    void gather(int i, std::vector<uint64_t> &out) const {
+        const Slot &s = slots_[i];
+        size_t left = s.count;
+        for (int chunk = s.first_chunk; chunk != -1 && left > 0; chunk = chunk_next_[chunk]) {
+            size_t n = left;
+            if (n > CHUNK_PACKETS) {
+                n = CHUNK_PACKETS;
+            }
+            const uint64_t *begin = &arena_[chunk * CHUNK_PACKETS];
+            out.insert(out.end(), begin, begin + n);
+            left -= n;
+        }
+    }
+
+    void release(int i) {
+        Slot &s = slots_[i];
+        for (int chunk = s.first_chunk; chunk != -1;) {
+            int next = chunk_next_[chunk];
+            free_chunks_.push_back(chunk);
+            chunk = next;
+        }
+        unlink(i);
+        index_.erase(s.flowkey);
+        s = Slot();
+        free_slots_.push_back(i);
+    }
+
+    template <typename fn_t>
+    void forEachActive(fn_t &&fn) const {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].is_active) {
+                fn(static_cast<int>(i));
+            }
+        }
+    }
+
+    // Arena in use, i.e. the high-water mark of chunks held at once.
+    size_t arenaBytes() const { return arena_.size() * sizeof(uint64_t); }
+
+    // Slot table plus arena in use.
+    size_t bytes() const { return slots_.size() * sizeof(Slot) + arenaBytes(); }
+
+private:
+    std::vector<Slot> slots_;
+    std::vector<int> free_slots_;
+    core::FlatHashMap<FlowKey<13>, int, hash::FlowKeyHash> index_;
+    std::vector<uint64_t> arena_;
+    std::vector<int> chunk_next_;
+    std::vector<int> free_chunks_;
+    int head_ = -1;
+    int tail_ = -1;
+
+    int newChunk() {
+        int chunk;
+        if (!free_chunks_.empty()) {
+            chunk = free_chunks_.back();
+            free_chunks_.pop_back();
+        } else {
+            chunk = static_cast<int>(chunk_next_.size());
+            chunk_next_.push_back(-1);
+            arena_.resize(arena_.size() + CHUNK_PACKETS);
+        }
+        chunk_next_[chunk] = -1;
+        return chunk;
+    }
+
+    void pushBack(int i) {
+        slots_[i].prev = tail_;
+        slots_[i].next = -1;
+        (tail_ != -1 ? slots_[tail_].next : head_) = i;
+        tail_ = i;
+    }
+
+    void unlink(int i) {
+        Slot &s = slots_[i];
+        (s.prev != -1 ? slots_[s.prev].next : head_) = s.next;
+        (s.next != -1 ? slots_[s.next].prev : tail_) = s.prev;
+        s.prev = s.next = -1;
+    }
+};
+
+#endif // EXPERIMENT_BUFFERPOOL_HH
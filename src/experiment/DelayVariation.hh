@@ -0,0 +1,113 @@
+#ifndef EXPERIMENT_DELAYVARIATION_HH
+#define EXPERIMENT_DELAYVARIATION_HH
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streaming delay variation of one flow: max |t_i - t_k - (i - k) * X_a|
+// over its packets in time order, where X_a = (t_last - t_first) / (n - 1).
+//
+// With u_i = t_i - i * X_a the metric is max u - min u. X_a is only known
+// at the end, but for any slope the maximum of t_i - i * X is reached on
+// the upper convex hull of the points (i, t_i) and the minimum on the
+// lower hull. add() keeps just the two hulls (monotone chain, amortized
+// O(1) per packet) and value() scans them once. For arrival processes the
+// hulls stay small (logarithmic in the packet count for stationary
+// traffic) but a flow whose rate drifts steadily can keep more vertices.
+class DelayVariation {
+public:
+    // Timestamps must come in nondecreasing order.
+    void add(uint64_t t) {
+        Point p{static_cast<int64_t>(n_), t};
+        if (n_ == 0) {
+            first_ = t;
+        }
+        last_ = t;
+        ++n_;
+        push(upper_, p, true);
+        push(lower_, p, false);
+    }
+
+    size_t count() const { return n_; }
+
+    // The metric, rounded down to microseconds like the O(n^2) definition.
+    uint64_t value() const {
+        if (n_ < 2) {
+            return 0;
+        }
+        double X_a = static_cast<double>(last_ - first_) / (n_ - 1);
+        double hi = offset(upper_.front(), X_a);
+        double lo = offset(lower_.front(), X_a);
+        for (const auto &p : upper_) {
+            hi = std::max(hi, offset(p, X_a));
+        }
+        for (const auto &p : lower_) {
+            lo = std::min(lo, offset(p, X_a));
+        }
+        // The extremes are often tied (u_0 == u_{n-1} by the choice of
+        // X_a), so every pair within a microsecond of them is evaluated the
+        // way the pairwise definition rounds it.
+        double max_variation = 0.0;
+        for (const auto &p : upper_) {
+            if (offset(p, X_a) < hi - 1.0) {
+                continue;
+            }
+            for (const auto &q : lower_) {
+                if (offset(q, X_a) <= lo + 1.0) {
+                    max_variation = std::max(max_variation, variation(p, q, X_a));
+                }
+            }
+        }
+        return static_cast<uint64_t>(max_variation);
+    }
+
+    // Hull vertices held, i.e. the state size beyond the fixed fields.
+    size_t hullPoints() const { return upper_.size() + lower_.size(); }
+
+private:
+    struct Point {
+        int64_t i;
+        uint64_t t;
+    };
+
+    size_t n_ = 0;
+    uint64_t first_ = 0;
+    uint64_t last_ = 0;
+    std::vector<Point> upper_;
+    std::vector<Point> lower_;
+
+    static double offset(const Point &p, double X_a) {
+        return static_cast<double>(p.t) - static_cast<double>(p.i) * X_a;
+    }
+
+    static double variation(const Point &p, const Point &q, double X_a) {
+        return std::abs(static_cast<double>(p.t) - static_cast<double>(q.t) -
+                        (static_cast<double>(p.i) - static_cast<double>(q.i)) * X_a);
+    }
+
+    // Cross product of (b - a) and (c - a); exact, the products need more
+    // than 64 bits.
+    static __int128 cross(const Point &a, const Point &b, const Point &c) {
+        __int128 bt = static_cast<__int128>(b.t) - a.t;
+        __int128 ct = static_cast<__int128>(c.t) - a.t;
+        return static_cast<__int128>(b.i - a.i) * ct - bt * (c.i - a.i);
+    }
+
+    // Middle points on a straight edge are dropped: they never beat both
+    // ends.
+    static void push(std::vector<Point> &hull, const Point &p, bool upper) {
+        while (hull.size() >= 2) {
+            __int128 turn = cross(hull[hull.size() - 2], hull.back(), p);
+            if (upper ? turn < 0 : turn > 0) {
+                break;
+            }
+            hull.pop_back();
+        }
+        hull.push_back(p);
+    }
+};
+
+#endif // EXPERIMENT_DELAYVARIATION_HH
@@ -0,0 +1,220 @@
+#ifndef EXPERIMENT_DETECTORFACTORY_HH
+#define EXPERIMENT_DETECTORFACTORY_HH
+
+#include "utils/core.hh"
+#include "utils/hash.hh"
+#include "sketch/FDFilterFactory.hh"
+#include "sketch/DelaySketch.hh"
+#include "sketch/JitterSketch.hh"
+#include "sketch/JitterSketchS1Opt.hh"
+#include <memory>
+#include <string>
+
+// Detector parameters from settings.conf, in a plain struct so that the
+// tests, the benchmark and parameter sweeps can all size detectors from a
+// memory budget the same way and override single fields.
+struct DetectorConfig {
+    // [general]
+    double jitter_factor;
+    uint64_t min_absolute_jitter_thres;
+    uint64_t max_ifpd_diff;
+    int jitter_detection_mode;
+    int frequency_threshold;
+    long mem_size;
+
+    struct {
+        int k, kk, num_hash, gnum_hash;
+        long nbits, gnbits;
+        uint64_t delay_thres;
+        double ifpd_map_ratio, cm_sketch_ratio;
+        int cm_depth;
+        bool cm_conservative;
+        double gbf_max_fill;
+    } fd;
+
+    struct {
+        int d;
+        double ifpd_map_ratio, cm_sketch_ratio;
+        int cm_depth;
+        bool cm_conservative;
+    } ds;
+
+    struct {
+        double stage_one_ratio, stage_two_ratio;
+        int d3;
+    } js;
+
+    struct {
+        double stage_one_ratio, stage_two_ratio;
+        int d3, s1_hash_num;
+    } s1opt;
+
+    static DetectorConfig load(std::shared_ptr<INIReader> config) {
+        DetectorConfig c;
+        c.jitter_factor = config->GetReal("general", "jitter_factor", 2.0);
+        c.min_absolute_jitter_thres = config->GetInteger("general", "min_absolute_jitter_thres", 500);
+        c.max_ifpd_diff = config->GetInteger("general", "max_ifpd_diff", 1000000);
+        c.jitter_detection_mode = config->GetInteger("general", "jitter_detection_mode", 2);
+        c.frequency_threshold = config->GetInteger("general", "frequency_threshold", 30);
+        c.mem_size = config->GetInteger("general", "mem_size", 0);
+
+        c.fd.delay_thres = config->GetInteger("FDFilter", "delay_thres", 0);
+        c.fd.k = config->GetInteger("FDFilter", "k", 0);
+        c.fd.kk = config->GetInteger("FDFilter", "kk", 0);
+        c.fd.num_hash = config->GetInteger("FDFilter", "num_hash", 0);
+        c.fd.gnum_hash = config->GetInteger("FDFilter", "gnum_hash", 0);
+        c.fd.nbits = config->GetInteger("FDFilter", "nbits", 0);
+        c.fd.gnbits = config->GetInteger("FDFilter", "gnbits", 0);
+        c.fd.ifpd_map_ratio = config->GetReal("FDFilter", "ifpd_map_ratio", 0.1);
+        c.fd.cm_sketch_ratio = config->GetReal("FDFilter", "cm_sketch_ratio", 0.1);
+        c.fd.cm_depth = config->GetInteger("FDFilter", "cm_depth", 4);
+        c.fd.cm_conservative = config->GetBoolean("FDFilter", "cm_conservative", false);
+        c.fd.gbf_max_fill = config->GetReal("FDFilter", "gbf_max_fill", 0.0);
+
+        c.ds.d = config->GetInteger("DelaySketch", "d", 4);
+        c.ds.ifpd_map_ratio = config->GetReal("DelaySketch", "ifpd_map_ratio", 0.3);
+        c.ds.cm_sketch_ratio = config->GetReal("DelaySketch", "cm_sketch_ratio", 0.3);
+        c.ds.cm_depth = config->GetInteger("DelaySketch", "cm_depth", 4);
+        c.ds.cm_conservative = config->GetBoolean("DelaySketch", "cm_conservative", false);
+
+        c.js.stage_one_ratio = config->GetReal("JitterSketch", "stage_one_ratio", 0.2);
+        c.js.stage_two_ratio = config->GetReal("JitterSketch", "stage_two_ratio", 0.4);
+        c.js.d3 = config->GetInteger("JitterSketch", "d3", 4);
+
+        c.s1opt.stage_one_ratio = config->GetReal("JitterSketchS1Opt", "stage_one_ratio", 0.2);
+        c.s1opt.stage_two_ratio = config->GetReal("JitterSketchS1Opt", "stage_two_ratio", 0.4);
+        c.s1opt.d3 = config->GetInteger("JitterSketchS1Opt", "d3", 4);
+        c.s1opt.s1_hash_num = config->GetInteger("JitterSketchS1Opt", "s1_hash_num", 3);
+        return c;
+    }
+};
+
+// Each with*() builds the detector sized to c.mem_size and passes it to fn.
+
+template <typename fn_t>
+void withFDFilter(const DetectorConfig &c, fn_t &&fn) {
+    size_t ifpd_entry_size = sketch::IfpdTable<hash::AwareHash>::ENTRY_BYTES;
+    size_t cm_entry_size = sizeof(uint32_t);
+
+    size_t ifpd_map_mem_bytes = static_cast<size_t>(c.mem_size * c.fd.ifpd_map_ratio);
+    size_t ifpd_map_size = ifpd_entry_size > 0 ? ifpd_map_mem_bytes / ifpd_entry_size : 0;
+
+    size_t cm_sketch_mem_bytes = static_cast<size_t>(c.mem_size * c.fd.cm_sketch_ratio);
+    int cm_width = (c.fd.cm_depth > 0 && cm_entry_size > 0) ? cm_sketch_mem_bytes / (c.fd.cm_depth * cm_entry_size) : 0;
+
+    long bf_mem_bytes = c.mem_size - ifpd_map_mem_bytes - cm_sketch_mem_bytes;
+    uint64_t bf_mem_bits = bf_mem_bytes > 0 ? bf_mem_bytes * 8 : 0;
+    uint64_t total_conf_ratio_units = (uint64_t)(c.fd.k + 1) * c.fd.kk * c.fd.nbits + c.fd.gnbits;
+    int gnbits = 0;
+    int nbits = 0;
+    if (total_conf_ratio_units > 0 && bf_mem_bits > 0) {
+        gnbits = static_cast<int>((bf_mem_bits * c.fd.gnbits) / total_conf_ratio_units);
+        uint64_t all_bfs_bits = bf_mem_bits - gnbits;
+        if ((c.fd.k + 1) * c.fd.kk > 0) {
+            nbits = static_cast<int>(all_bfs_bits / ((c.fd.k + 1) * c.fd.kk));
+        }
+    }
+
+    sketch::dispatchFDFilter<hash::AwareHash>(fn, c.fd.k, c.fd.kk, nbits, c.fd.num_hash, gnbits, c.fd.gnum_hash,
+                                              c.fd.delay_thres, c.jitter_factor, c.min_absolute_jitter_thres,
+                                              c.max_ifpd_diff, ifpd_map_size, cm_width, c.fd.cm_depth,
+                                              c.jitter_detection_mode, c.frequency_threshold,
+                                              c.fd.cm_conservative, c.fd.gbf_max_fill);
+}
+
+template <typename fn_t>
+void withDelaySketch(const DetectorConfig &c, fn_t &&fn) {
+    size_t ifpd_entry_size = sketch::IfpdTable<hash::AwareHash>::ENTRY_BYTES;
+    size_t cm_entry_size = sizeof(uint32_t);
+    size_t ds_line_size = sizeof(sketch::DelaySketchLine);
+
+    size_t ifpd_map_mem_bytes = static_cast<size_t>(c.mem_size * c.ds.ifpd_map_ratio);
+    size_t ifpd_map_size = ifpd_entry_size > 0 ? ifpd_map_mem_bytes / ifpd_entry_size : 0;
+
+    size_t cm_sketch_mem_bytes = static_cast<size_t>(c.mem_size * c.ds.cm_sketch_ratio);
+    int cm_width = (c.ds.cm_depth > 0 && cm_entry_size > 0) ? cm_sketch_mem_bytes / (c.ds.cm_depth * cm_entry_size) : 0;
+
+    long delay_sketch_mem_bytes = c.mem_size - ifpd_map_mem_bytes - cm_sketch_mem_bytes;
+    int num_lines = 0;
+    if (delay_sketch_mem_bytes > 0 && ds_line_size > 0) {
+        num_lines = delay_sketch_mem_bytes / ds_line_size;
+    }
+
+    sketch::DelaySketch<hash::AwareHash> delay_sketch(c.ds.d, num_lines, c.jitter_factor, c.min_absolute_jitter_thres,
+                                                      c.max_ifpd_diff, ifpd_map_size, cm_width, c.ds.cm_depth,
+                                                      c.jitter_detection_mode, c.frequency_threshold, c.ds.cm_conservative);
+    fn(delay_sketch);
+}
+
+template <typename fn_t>
+void withJitterSketch(const DetectorConfig &c, fn_t &&fn) {
+    size_t s1_bucket_size = sizeof(sketch::JitterSketchStageOneBucket);
+    size_t s2_bucket_size = sizeof(sketch::JitterSketchStageTwoBucket);
+    size_t s3_entry_size = sizeof(sketch::JitterSketchStageThreeEntry);
+
+    size_t s1_mem_bytes = static_cast<size_t>(c.mem_size * c.js.stage_one_ratio);
+    int w1 = s1_bucket_size > 0 ? s1_mem_bytes / s1_bucket_size : 0;
+
+    size_t s2_mem_bytes = static_cast<size_t>(c.mem_size * c.js.stage_two_ratio);
+    int w2 = s2_bucket_size > 0 ? s2_mem_bytes / s2_bucket_size : 0;
+
+    long s3_mem_bytes = c.mem_size - s1_mem_bytes - s2_mem_bytes;
+    int w3 = 0;
+    if (c.js.d3 > 0 && s3_mem_bytes > 0 && s3_entry_size > 0) {
+        w3 = s3_mem_bytes / (c.js.d3 * s3_entry_size);
+    }
+
+    sketch::JitterSketch<hash::AwareHash> jitter_sketch(w1, w2, w3, c.js.d3, c.jitter_factor,
+                                                        c.min_absolute_jitter_thres, c.max_ifpd_diff,
+                                                        c.jitter_detection_mode, c.frequency_threshold);
+    fn(jitter_sketch);
+}
+
+template <typename fn_t>
+void withJitterSketchS1Opt(const DetectorConfig &c, fn_t &&fn) {
+    size_t s1_bucket_size = sizeof(sketch::JitterSketchS1OptStageOneBucket);
+    size_t s2_bucket_size = sizeof(sketch::JitterSketchS1OptStageTwoBucket);
+    size_t s3_entry_size = sizeof(sketch::JitterSketchS1OptStageThreeEntry);
+
+    size_t s1_mem_bytes = static_cast<size_t>(c.mem_size * c.s1opt.stage_one_ratio);
+    int w1 = s1_bucket_size > 0 ? s1_mem_bytes / s1_bucket_size : 0;
+
+    size_t s2_mem_bytes = static_cast<size_t>(c.mem_size * c.s1opt.stage_two_ratio);
+    int w2 = s2_bucket_size > 0 ? s2_mem_bytes / s2_bucket_size : 0;
+
+    long s3_mem_bytes = c.mem_size - s1_mem_bytes - s2_mem_bytes;
+    int w3 = 0;
+    if (c.s1opt.d3 > 0 && s3_mem_bytes > 0 && s3_entry_size > 0) {
+        w3 = s3_mem_bytes / (c.s1opt.d3 * s3_entry_size);
+    }
+
+    sketch::JitterSketchS1Opt<hash::AwareHash> jitter_sketch_s1_opt(w1, w2, w3, c.s1opt.d3, c.s1opt.s1_hash_num,
+                                                                    c.jitter_factor, c.min_absolute_jitter_thres,
+                                                                    c.max_ifpd_diff, c.jitter_detection_mode,
+                                                                    c.frequency_threshold);
+    fn(jitter_sketch_s1_opt);
+}
+
+inline bool isDetectorName(const std::string &name) {
+    return name == "FDFilter" || name == "DelaySketch" || name == "JitterSketch" || name == "JitterSketchS1Opt";
+}
+
+// Builds the detector called name ("FDFilter", "DelaySketch",
+// "JitterSketch" or "JitterSketchS1Opt"). Returns false for other names.
+template <typename fn_t>
+bool withDetector(const std::string &name, const DetectorConfig &c, fn_t &&fn) {
+    if (name == "FDFilter") {
+        withFDFilter(c, fn);
+    } else if (name == "DelaySketch") {
+        withDelaySketch(c, fn);
+    } else if (name == "JitterSketch") {
+        withJitterSketch(c, fn);
+    } else if (name == "JitterSketchS1Opt") {
+        withJitterSketchS1Opt(c, fn);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#endif // EXPERIMENT_DETECTORFACTORY_HH
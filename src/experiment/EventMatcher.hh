@@ -0,0 +1,187 @@
+#ifndef EXPERIMENT_EVENTMATCHER_HH
+#define EXPERIMENT_EVENTMATCHER_HH
+
+#include "utils/flowkey.hh"
+#include "utils/hash.hh"
+#include "utils/FlatHashMap.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+struct MatchCounts {
+    uint64_t tp = 0;
+    uint64_t fp = 0;
+    uint64_t fn = 0;
+
+    double precision() const { return (tp + fp) > 0 ? 1.0 * tp / (tp + fp) : 0; }
+    double recall() const { return (tp + fn) > 0 ? 1.0 * tp / (tp + fn) : 0; }
+    double f1() const {
+        double p = precision(), r = recall();
+        return (p + r) > 0 ? 2.0 * p * r / (p + r) : 0;
+    }
+};
+
+// Matches detected jitter events against ground truth, per flow.
+//
+// Each sketch event, in timestamp order, claims the earliest unclaimed
+// truth event of its flow within time_threshold (and, in matching mode 1,
+// within ifpd_threshold on both IFPDs). Because the window's lower edge
+// only moves forward, truth events that are claimed or have fallen out of
+// the window are popped for good, and in mode 0 the claim is always the
+// front of the flow's queue: two pointers instead of a scan over all truth
+// events per sketch event.
+//
+// Online use (the fan-out consumers): add*() both streams in timestamp
+// order and call advance() with a watermark below which both streams are
+// complete; a sketch event is matched once every truth event that could
+// pair with it has arrived. finish() drains the rest, and the counts equal
+// match() over the same events. match() is the batch form: flows are split by
+// hash across threads and each thread runs its own matcher.
+class EventMatcher {
+public:
+    using Event = std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>;
+
+    // The evaluation's defaults: 0.5 s time tolerance, timestamps only.
+    static constexpr uint64_t DEFAULT_TIME_THRESHOLD = 500000;
+    static constexpr uint64_t DEFAULT_IFPD_THRESHOLD = 500;
+
+private:
+    struct TruthEvent {
+        uint64_t old_ifpd;
+        uint64_t new_ifpd;
+        uint64_t ts;
+        bool matched;
+    };
+    using FlowQueue = std::deque<TruthEvent>;
+
+    uint64_t time_threshold_;
+    int matching_mode_;
+    uint64_t ifpd_threshold_;
+    core::FlatHashMap<FlowKey<13>, FlowQueue, hash::FlowKeyHash> truth_;
+    std::deque<Event> pending_;
+    MatchCounts counts_;
+    uint64_t truth_total_ = 0;
+    uint64_t sketch_total_ = 0;
+
+    static inline uint64_t absDiff(uint64_t a, uint64_t b) { return a > b ? a - b : b - a; }
+
+    void matchOne(const Event &event) {
+        FlowQueue *queue = truth_.find(std::get<0>(event));
+        if (!queue) {
+            return;
+        }
+        uint64_t ts = std::get<3>(event);
+        uint64_t lower = ts > time_threshold_ ? ts - time_threshold_ : 0;
+        while (!queue->empty() && (queue->front().matched || queue->front().ts < lower)) {
+            queue->pop_front();
+        }
+        for (auto &truth : *queue) {
+            if (truth.ts > ts + time_threshold_) {
+                break;
+            }
+            if (truth.matched) {
+                continue;
+            }
+            if (matching_mode_ != 0 && (absDiff(std::get<1>(event), truth.old_ifpd) > ifpd_threshold_ ||
+                                        absDiff(std::get<2>(event), truth.new_ifpd) > ifpd_threshold_)) {
+                continue;
+            }
+            truth.matched = true;
+            ++counts_.tp;
+            return;
+        }
+    }
+
+public:
+    EventMatcher(uint64_t time_threshold, int matching_mode = 0, uint64_t ifpd_threshold = 0)
+            : time_threshold_(time_threshold), matching_mode_(matching_mode), ifpd_threshold_(ifpd_threshold) {}
+
+    void addTruth(const Event &event) {
+        truth_[std::get<0>(event)].push_back({std::get<1>(event), std::get<2>(event), std::get<3>(event), false});
+        ++truth_total_;
+    }
+
+    void addSketch(const Event &event) {
+        pending_.push_back(event);
+        ++sketch_total_;
+    }
+
+    // Both streams are complete for timestamps below watermark.
+    void advance(uint64_t watermark) {
+        while (!pending_.empty() && std::get<3>(pending_.front()) + time_threshold_ < watermark) {
+            matchOne(pending_.front());
+            pending_.pop_front();
+        }
+    }
+
+    MatchCounts finish() {
+        for (const auto &event : pending_) {
+            matchOne(event);
+        }
+        pending_.clear();
+        counts_.fp = sketch_total_ - counts_.tp;
+        counts_.fn = truth_total_ - counts_.tp;
+        return counts_;
+    }
+
+    static MatchCounts match(const std::vector<Event> &sketch_events, const std::vector<Event> &truth_events,
+                             uint64_t time_threshold, int matching_mode = 0, uint64_t ifpd_threshold = 0,
+                             unsigned num_threads = 0) {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (sketch_events.size() + truth_events.size() < 100000) {
+            num_threads = 1;
+        }
+
+        std::vector<MatchCounts> partial(num_threads);
+        auto worker = [&](unsigned t) {
+            auto by_ts = [](const Event *a, const Event *b) { return std::get<3>(*a) < std::get<3>(*b); };
+            std::vector<const Event *> truth, sketch;
+            for (const auto &event : truth_events) {
+                if (num_threads == 1 || hash::FlowKeyHash::partition(std::get<0>(event), num_threads) == t) {
+                    truth.push_back(&event);
+                }
+            }
+            for (const auto &event : sketch_events) {
+                if (num_threads == 1 || hash::FlowKeyHash::partition(std::get<0>(event), num_threads) == t) {
+                    sketch.push_back(&event);
+                }
+            }
+            std::stable_sort(truth.begin(), truth.end(), by_ts);
+            std::stable_sort(sketch.begin(), sketch.end(), by_ts);
+
+            EventMatcher matcher(time_threshold, matching_mode, ifpd_threshold);
+            for (const Event *event : truth) {
+                matcher.addTruth(*event);
+            }
+            for (const Event *event : sketch) {
+                matcher.addSketch(*event);
+            }
+            partial[t] = matcher.finish();
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < num_threads; ++t) {
+            workers.emplace_back(worker, t);
+        }
+        worker(0);
+        for (auto &w : workers) {
+            w.join();
+        }
+
+        MatchCounts total;
+        for (const auto &counts : partial) {
+            total.tp += counts.tp;
+            total.fp += counts.fp;
+            total.fn += counts.fn;
+        }
+        return total;
+    }
+};
+
+#endif // EXPERIMENT_EVENTMATCHER_HH
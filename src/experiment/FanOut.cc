@@ -0,0 +1,171 @@
+#include "experiment/FanOut.hh"
+#include "experiment/DetectorFactory.hh"
+#include "experiment/EventMatcher.hh"
+#include "detector/GroundTruthDetector.hh"
+#include "utils/BOBHash.hh"
+#include "utils/BroadcastRing.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace {
+
+    using Batch = std::vector<core::Record>;
+
+    struct ConsumerStats {
+        uint64_t packets = 0;
+        double busy_seconds = 0;    // inside updateBatch()
+        double wall_seconds = 0;    // first batch to last
+        size_t bytes = 0;
+        MatchCounts counts;         // matched online, batch by batch
+        MatchCounts batch_counts;   // EventMatcher::match() over the whole run
+    };
+
+    // Events are matched while the detector runs: after each batch, the
+    // sketch's new events and the truth events before the batch's last
+    // timestamp go to the matcher, and that timestamp is its watermark.
+    // truth_by_ts is truth sorted by timestamp.
+    template <typename sketch_t>
+    void consume(sketch_t &sketch, core::BroadcastRing<Batch> &ring, size_t self,
+                 const std::vector<GroundTruthDetector::Event> &truth,
+                 const std::vector<const GroundTruthDetector::Event *> &truth_by_ts, ConsumerStats &stats) {
+        using clock = std::chrono::steady_clock;
+        sketch.clear();
+        EventMatcher matcher(EventMatcher::DEFAULT_TIME_THRESHOLD, 0, EventMatcher::DEFAULT_IFPD_THRESHOLD);
+        size_t next_truth = 0, next_event = 0;
+        bool started = false;
+        clock::time_point first;
+        while (const Batch *batch = ring.peek(self)) {
+            if (!started) {
+                sketch.setInitTime(batch->front().timestamp_);
+                first = clock::now();
+                started = true;
+            }
+            auto start = clock::now();
+            sketch.updateBatch(batch->data(), batch->size());
+            stats.busy_seconds += std::chrono::duration<double>(clock::now() - start).count();
+            stats.packets += batch->size();
+            uint64_t watermark = batch->back().timestamp_;
+            ring.release(self);
+
+            const auto &events = sketch.getAbnormalEvents();
+            for (; next_event < events.size(); ++next_event) {
+                matcher.addSketch(events[next_event]);
+            }
+            for (; next_truth < truth_by_ts.size() && std::get<3>(*truth_by_ts[next_truth]) < watermark; ++next_truth) {
+                matcher.addTruth(*truth_by_ts[next_truth]);
+            }
+            matcher.advance(watermark);
+        }
+        if (started) {
+            stats.wall_seconds = std::chrono::duration<double>(clock::now() - first).count();
+        }
+        stats.bytes = sketch.size();
+        const auto &events = sketch.getAbnormalEvents();
+        for (; next_event < events.size(); ++next_event) {
+            matcher.addSketch(events[next_event]);
+        }
+        for (; next_truth < truth_by_ts.size(); ++next_truth) {
+            matcher.addTruth(*truth_by_ts[next_truth]);
+        }
+        stats.counts = matcher.finish();
+        stats.batch_counts = EventMatcher::match(events, truth, EventMatcher::DEFAULT_TIME_THRESHOLD, 0,
+                                                 EventMatcher::DEFAULT_IFPD_THRESHOLD, 1);
+    }
+
+} // namespace
+
+int runFanOut(std::shared_ptr<INIReader> config, const std::vector<core::Record> &records) {
+    if (records.empty()) {
+        printf("FanOut: empty trace\n");
+        return 1;
+    }
+    std::vector<std::string> detectors = core::split_list(
+            config->Get("FanOut", "detectors", "FDFilter,DelaySketch,JitterSketch,JitterSketchS1Opt"));
+    size_t batch_size = static_cast<size_t>(config->GetInteger("FanOut", "batch_size", 256));
+    size_t ring_slots = static_cast<size_t>(config->GetInteger("FanOut", "ring_slots", 64));
+    if (detectors.empty() || batch_size == 0 || ring_slots == 0) {
+        printf("FanOut: need detectors, batch_size > 0 and ring_slots > 0\n");
+        return 1;
+    }
+    for (const auto &name : detectors) {
+        if (!isDetectorName(name)) {
+            printf("FanOut: unknown detector '%s'\n", name.c_str());
+            return 1;
+        }
+    }
+
+    DetectorConfig c = DetectorConfig::load(config);
+    GroundTruthDetector truth(c.jitter_factor, c.min_absolute_jitter_thres, c.max_ifpd_diff, c.jitter_detection_mode,
+                              c.frequency_threshold);
+    truth.run(records, GroundTruthOptions::load(config));
+    const auto &truth_events = truth.getAbnormalEvents();
+    std::vector<const GroundTruthDetector::Event *> truth_by_ts;
+    for (const auto &event : truth_events) {
+        truth_by_ts.push_back(&event);
+    }
+    std::stable_sort(truth_by_ts.begin(), truth_by_ts.end(),
+                     [](const GroundTruthDetector::Event *a, const GroundTruthDetector::Event *b) {
+                         return std::get<3>(*a) < std::get<3>(*b);
+                     });
+
+    core::BroadcastRing<Batch> ring(ring_slots, detectors.size());
+    for (auto &slot : ring.slots()) {
+        slot.reserve(batch_size);
+    }
+    std::vector<ConsumerStats> stats(detectors.size());
+
+    printf("--- FanOut: %zu detectors, %zu-packet batches, %zu-slot ring ---\n", detectors.size(), batch_size,
+           ring.capacity());
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> consumers;
+    for (size_t i = 0; i < detectors.size(); ++i) {
+        consumers.emplace_back([&, i]() {
+            // Same hash seeds on every run, whatever the thread interleaving.
+            hash::AwareHash::reseed(hash::AwareHash::DEFAULT_SEED);
+            hash::BOBHash32::reseed(hash::AwareHash::DEFAULT_SEED);
+            withDetector(detectors[i], c, [&](auto &sketch) {
+                consume(sketch, ring, i, truth_events, truth_by_ts, stats[i]);
+            });
+        });
+    }
+
+    // Reader: the stream is cut into batches and each batch is written once.
+    for (size_t pos = 0; pos < records.size(); pos += batch_size) {
+        size_t end = std::min(records.size(), pos + batch_size);
+        Batch &batch = ring.claim();
+        batch.assign(records.begin() + pos, records.begin() + end);
+        ring.publish();
+    }
+    ring.close();
+    double reader_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto &consumer : consumers) {
+        consumer.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf(" Reader: %zu packets in %.2f ms, stalled on a full ring %llu times\n", records.size(),
+           reader_seconds * 1000, static_cast<unsigned long long>(ring.producerWaits()));
+    for (size_t i = 0; i < detectors.size(); ++i) {
+        const ConsumerStats &s = stats[i];
+        printf(" %-18s %llu packets, busy %.2f ms (%.2f Mpps), wall %.2f ms, ring empty %llu times, %zu bytes\n",
+               detectors[i].c_str(), static_cast<unsigned long long>(s.packets), s.busy_seconds * 1000,
+               s.busy_seconds > 0 ? s.packets / s.busy_seconds / 1e6 : 0, s.wall_seconds * 1000,
+               static_cast<unsigned long long>(ring.consumerWaits(i)), s.bytes);
+        printf(" %-18s Precision: %g Recall: %g F1 Score: %g\n", "", s.counts.precision(), s.counts.recall(),
+               s.counts.f1());
+        if (s.counts.tp != s.batch_counts.tp || s.counts.fp != s.batch_counts.fp || s.counts.fn != s.batch_counts.fn) {
+            printf(" %-18s online matching differs from match(): TP/FP/FN %llu/%llu/%llu vs %llu/%llu/%llu\n", "",
+                   static_cast<unsigned long long>(s.counts.tp), static_cast<unsigned long long>(s.counts.fp),
+                   static_cast<unsigned long long>(s.counts.fn), static_cast<unsigned long long>(s.batch_counts.tp),
+                   static_cast<unsigned long long>(s.batch_counts.fp),
+                   static_cast<unsigned long long>(s.batch_counts.fn));
+        }
+    }
+    printf(" Total (with matching): %.2f ms, %.2f Mpps end to end\n\n", elapsed * 1000, records.size() / elapsed / 1e6);
+    return 0;
+}
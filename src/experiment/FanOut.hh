@@ -0,0 +1,21 @@
+#ifndef EXPERIMENT_FANOUT_HH
+#define EXPERIMENT_FANOUT_HH
+
+#include "utils/core.hh"
+#include <memory>
+#include <vector>
+
+// Runs several detectors side by side on one pass over the packet stream.
+//
+// A reader thread cuts the stream into batches ([FanOut] batch_size
+// packets) and publishes each batch once into a broadcast ring
+// (ring_slots batches deep). Each detector listed in [FanOut] detectors
+// runs on its own thread, is built there from the settings.conf memory
+// budget, and consumes the ring at its own pace. A detector that falls a
+// full ring behind stalls the reader; the others keep going until they
+// catch up with it. Per detector, the report gives packets, busy time
+// spent in update(), Mpps over that time, how often the detector found
+// the ring empty, and accuracy against the ground truth.
+int runFanOut(std::shared_ptr<INIReader> config, const std::vector<core::Record> &records);
+
+#endif // EXPERIMENT_FANOUT_HH
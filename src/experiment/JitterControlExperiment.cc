@@ -1,19 +1,33 @@
 #include "JitterControlExperiment.hh"
+#include "experiment/BufferPool.hh"
+#include "experiment/DelayVariation.hh"
+#include "utils/FlatHashMap.hh"
 #include "utils/INIReader.h"
+#include "utils/IndexedHeap.hh"
+#include "utils/WorkStealingPool.hh"
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
-#include <map>
+#include <iterator>
+#include <limits>
 #include "utils/flowkey.hh"
 #include <vector>
 #include "optimizer/JitterSketchOptimizer.hh"
 
-struct BufferSlot {
-    FlowKey<13> flowkey;
-    uint64_t last_arrival_time = 0;
-    std::vector<uint64_t> timestamps;
-    bool is_active = false;
-};
+namespace {
+
+    // Delay variation of one flow before and after optimization. Release
+    // times come back a buffer at a time and a buffer's tail can overlap
+    // the next buffer of the same flow, so releases later than the packet
+    // that flushed the buffer are held back until no later buffer can
+    // release before them.
+    struct FlowVariation {
+        DelayVariation original;
+        DelayVariation optimized;
+        std::vector<uint64_t> held;
+    };
+
+} // namespace
 
 JitterControlExperiment::JitterControlExperiment(const std::vector<core::Record>& records,
                                                  std::shared_ptr<JitterOptimizer> optimizer,
@@ -23,40 +37,11 @@ JitterControlExperiment::JitterControlExperiment(const std::vector<core::Record>
     max_buffers_ = config->GetInteger("JitterControlExperiment", "max_buffers", 100);
     buffer_timeout_us_ = config->GetInteger("JitterControlExperiment", "buffer_timeout_us", 2000000);
     B_size_ = config->GetInteger("JitterControlExperiment", "B_size", 10);
+    threads_ = config->GetInteger("JitterControlExperiment", "threads", 0);
+    preempt_ = config->GetBoolean("JitterControlExperiment", "preempt", true);
+    preempt_margin_ = config->GetReal("JitterControlExperiment", "preempt_margin", 2.0);
 }
 
-uint64_t JitterControlExperiment::calculateDelayVariation(const std::vector<uint64_t>& timestamps) {
-    if (timestamps.size() < 2) return 0;
-    double X_a = static_cast<double>(timestamps.back() - timestamps.front()) / (timestamps.size() - 1);
-    double max_variation = 0.0;
-    for (size_t i = 0; i < timestamps.size(); ++i) {
-        for (size_t k = 0; k < timestamps.size(); ++k) {
-            double current_variation = std::abs(
-                    static_cast<double>(timestamps[i]) - static_cast<double>(timestamps[k]) - (static_cast<double>(i) - static_cast<double>(k)) * X_a
-            );
-            if (current_variation > max_variation) {
-                max_variation = current_variation;
-            }
-        }
-    }
-    return static_cast<uint64_t>(max_variation);
-}
-
-int JitterControlExperiment::countVariationFlows(const std::map<FlowKey<13>, std::vector<uint64_t>>& all_timestamps) {
-    int variation_flow_count = 0;
-    for (auto const& [flowkey, timestamps_const] : all_timestamps) {
-        if (timestamps_const.size() >= static_cast<size_t>(frequency_threshold_)) {
-            std::vector<uint64_t> timestamps = timestamps_const;
-            std::sort(timestamps.begin(), timestamps.end());
-            if (calculateDelayVariation(timestamps) > 0) {
-                variation_flow_count++;
-            }
-        }
-    }
-    return variation_flow_count;
-}
-
-
 void JitterControlExperiment::run() {
     std::cout << "--- Jitter Optimization Experiment---" << std::endl;
     std::cout << "Using Optimizer: " << optimizer_->name() << std::endl;
@@ -71,42 +56,83 @@ void JitterControlExperiment::run() {
         return a.timestamp_ < b.timestamp_;
     });
 
-    std::vector<BufferSlot> buffer_pool(max_buffers_);
-    std::map<FlowKey<13>, int> flow_to_buffer_map;
+    BufferPool buffer_pool(max_buffers_);
+    // Buffers that expire together are optimized as one batch.
+    FlowBatch batch;
+    std::vector<int> batch_slots;
+    std::vector<uint64_t> released;
+    std::unique_ptr<core::WorkStealingPool> pool;
+    if (threads_ != 1) {
+        pool.reset(new core::WorkStealingPool(static_cast<unsigned>(threads_)));
+    }
 
-    std::map<FlowKey<13>, std::vector<uint64_t>> all_optimized_timestamps;
+    // Active buffers by their flow's severity, least severe on top. When
+    // the pool is full, a newly jittered flow takes the top buffer if it is
+    // more than preempt_margin_ times as severe; the victim is flushed as
+    // if it had timed out. Without the sketch every severity is 0 and
+    // nothing is preempted.
+    core::IndexedMinHeap<float> severities(buffer_pool.capacity());
+    uint64_t admitted = 0, preempted = 0, refused = 0;
+    size_t peak_active = 0;
+
+    core::FlatHashMap<FlowKey<13>, FlowVariation, hash::FlowKeyHash> flows;
+    std::vector<uint64_t> merged;
+    auto enqueue = [&](int i) {
+        buffer_pool.gather(i, batch.times);
+        batch.close();
+        batch_slots.push_back(i);
+    };
+    // Every later packet, and so every later release, of these flows is at
+    // or after 'now'.
+    auto flush = [&](uint64_t now) {
+        optimizer_->optimizeMany(batch, released, pool.get());
+        for (size_t f = 0; f < batch.flows(); ++f) {
+            int i = batch_slots[f];
+            auto begin = released.begin() + batch.offsets[f];
+            auto end = released.begin() + batch.offsets[f + 1];
+            if (!std::is_sorted(begin, end)) {
+                std::sort(begin, end);
+            }
+            FlowVariation& flow = flows[buffer_pool.slot(i).flowkey];
+            merged.clear();
+            std::merge(flow.held.begin(), flow.held.end(), begin, end, std::back_inserter(merged));
+            auto safe = std::upper_bound(merged.begin(), merged.end(), now);
+            for (auto it = merged.begin(); it != safe; ++it) {
+                flow.optimized.add(*it);
+            }
+            flow.held.assign(safe, merged.end());
+            severities.erase(i);
+            buffer_pool.release(i);
+        }
+        batch.clear();
+        batch_slots.clear();
+    };
 
     for (const auto& record : sorted_records) {
         uint64_t current_timestamp = record.timestamp_;
 
-        if (sketch_optimizer) {
-            sketch_optimizer->processPacket(record.flowkey_, current_timestamp);
-        }
+        bool jittered = sketch_optimizer && sketch_optimizer->processPacket(record.flowkey_, current_timestamp);
+        flows[record.flowkey_].original.add(current_timestamp);
 
-        for (int i = 0; i < max_buffers_; ++i) {
-            if (buffer_pool[i].is_active && (current_timestamp - buffer_pool[i].last_arrival_time > buffer_timeout_us_)) {
-                if (!buffer_pool[i].timestamps.empty()) {
-                    std::vector<uint64_t> optimized_chunk = optimizer_->optimize(buffer_pool[i].timestamps);
-                    all_optimized_timestamps[buffer_pool[i].flowkey].insert(
-                            all_optimized_timestamps[buffer_pool[i].flowkey].end(),
-                            optimized_chunk.begin(),
-                            optimized_chunk.end()
-                    );
-                }
-                flow_to_buffer_map.erase(buffer_pool[i].flowkey);
-                buffer_pool[i] = BufferSlot();
-            }
+        for (int i = buffer_pool.oldest();
+             i != -1 && current_timestamp - buffer_pool.slot(i).last_arrival_time > buffer_timeout_us_;
+             i = buffer_pool.slot(i).next) {
+            enqueue(i);
+        }
+        if (!batch_slots.empty()) {
+            flush(current_timestamp);
         }
 
-        auto it = flow_to_buffer_map.find(record.flowkey_);
-        if (it != flow_to_buffer_map.end()) {
-            int buffer_idx = it->second;
-            buffer_pool[buffer_idx].timestamps.push_back(current_timestamp);
-            buffer_pool[buffer_idx].last_arrival_time = current_timestamp;
+        int buffer_idx = buffer_pool.find(record.flowkey_);
+        if (buffer_idx != -1) {
+            buffer_pool.append(buffer_idx, current_timestamp);
+            if (jittered) {
+                severities.update(buffer_idx, sketch_optimizer->severity(record.flowkey_, current_timestamp));
+            }
         } else {
             bool allocate = false;
             if (sketch_optimizer) {
-                if (sketch_optimizer->hasJitter(record.flowkey_)) {
+                if (sketch_optimizer->hasJitter(record.flowkey_, current_timestamp)) {
                     allocate = true;
                 }
             } else {
@@ -114,73 +140,56 @@ void JitterControlExperiment::run() {
             }
 
             if (allocate) {
-                int free_idx = -1;
-                for (int i = 0; i < max_buffers_; ++i) {
-                    if (!buffer_pool[i].is_active) {
-                        free_idx = i;
-                        break;
-                    }
+                float severity = sketch_optimizer ? sketch_optimizer->severity(record.flowkey_, current_timestamp) : 0.0f;
+                if (buffer_pool.full() && preempt_ && !severities.empty() &&
+                    severity > preempt_margin_ * severities.topKey()) {
+                    enqueue(severities.top());
+                    flush(current_timestamp);
+                    preempted++;
                 }
-                if (free_idx != -1) {
-                    flow_to_buffer_map[record.flowkey_] = free_idx;
-                    buffer_pool[free_idx].is_active = true;
-                    buffer_pool[free_idx].flowkey = record.flowkey_;
-                    buffer_pool[free_idx].timestamps.push_back(current_timestamp);
-                    buffer_pool[free_idx].last_arrival_time = current_timestamp;
+                int i = buffer_pool.acquire(record.flowkey_, current_timestamp);
+                if (i == -1) {
+                    refused++;
+                } else {
+                    admitted++;
+                    severities.update(i, severity);
+                    peak_active = std::max(peak_active, buffer_pool.active());
                 }
             }
         }
     }
 
-    for (int i = 0; i < max_buffers_; ++i) {
-        if (buffer_pool[i].is_active && !buffer_pool[i].timestamps.empty()) {
-            std::vector<uint64_t> optimized_chunk = optimizer_->optimize(buffer_pool[i].timestamps);
-            all_optimized_timestamps[buffer_pool[i].flowkey].insert(
-                    all_optimized_timestamps[buffer_pool[i].flowkey].end(),
-                    optimized_chunk.begin(),
-                    optimized_chunk.end()
-            );
-        }
-    }
-
-    std::map<FlowKey<13>, std::vector<uint64_t>> all_original_timestamps;
-    for (const auto& record : records_) {
-        all_original_timestamps[record.flowkey_].push_back(record.timestamp_);
-    }
+    buffer_pool.forEachActive(enqueue);
+    flush(std::numeric_limits<uint64_t>::max());
 
     uint64_t total_original_variation = 0;
     uint64_t total_optimized_variation = 0;
-    int frequent_flow_count = 0;
-
-    std::map<FlowKey<13>, std::vector<uint64_t>> all_optimized_timestamps_for_analysis = all_original_timestamps;
-    for(auto const& [flowkey, optimized_stamps] : all_optimized_timestamps){
-        if(!optimized_stamps.empty()){
-            all_optimized_timestamps_for_analysis[flowkey] = optimized_stamps;
+    int original_variation_flows = 0;
+    int optimized_variation_flows = 0;
+    const size_t frequent = static_cast<size_t>(frequency_threshold_);
+
+    // A flow that was buffered is judged on its release times alone, one
+    // that never was on its arrivals.
+    flows.forEach([&](const FlowKey<13>&, FlowVariation& flow) {
+        for (uint64_t t : flow.held) {
+            flow.optimized.add(t);
         }
-    }
-
-
-    for (auto const& [flowkey, original_timestamps_const] : all_original_timestamps) {
-        if (original_timestamps_const.size() >= static_cast<size_t>(frequency_threshold_)) {
-            frequent_flow_count++;
-
-            std::vector<uint64_t> original_timestamps = original_timestamps_const;
-            std::sort(original_timestamps.begin(), original_timestamps.end());
-
-            total_original_variation += calculateDelayVariation(original_timestamps);
-
-            auto it = all_optimized_timestamps.find(flowkey);
-            if (it != all_optimized_timestamps.end() && !it->second.empty()) {
-                std::sort(it->second.begin(), it->second.end());
-                total_optimized_variation += calculateDelayVariation(it->second);
-            } else {
-                total_optimized_variation += calculateDelayVariation(original_timestamps);
+        flow.held.clear();
+
+        uint64_t original = flow.original.value();
+        const DelayVariation& after = flow.optimized.count() > 0 ? flow.optimized : flow.original;
+        uint64_t optimized = after.value();
+        if (flow.original.count() >= frequent) {
+            total_original_variation += original;
+            total_optimized_variation += optimized;
+            if (original > 0) {
+                original_variation_flows++;
             }
         }
-    }
-
-    int original_variation_flows = countVariationFlows(all_original_timestamps);
-    int optimized_variation_flows = countVariationFlows(all_optimized_timestamps_for_analysis);
+        if (after.count() >= frequent && optimized > 0) {
+            optimized_variation_flows++;
+        }
+    });
 
     std::cout << "Original Delay Variations Sum : " << total_original_variation << " us (" << total_original_variation / 1000.0 << " ms)" << std::endl;
     std::cout << "Optimized Delay Variations Sum : " << total_optimized_variation << " us (" << total_optimized_variation / 1000.0 << " ms)" << std::endl;
@@ -199,6 +208,18 @@ void JitterControlExperiment::run() {
         std::cout << "Variations flow Reduction: " << std::fixed << std::setprecision(2) << jitter_flow_reduction << "%" << std::endl;
     }
 
+    std::cout << "Buffers: " << max_buffers_ << " max, " << peak_active << " peak active, " << admitted << " admitted, "
+              << preempted << " preempted, " << refused << " refused" << std::endl;
+    // Per byte of buffer memory actually touched, to compare max_buffers
+    // settings; a negative value means buffering added variation.
+    size_t buffer_bytes = buffer_pool.bytes();
+    std::cout << "Buffer memory: " << buffer_bytes << " bytes" << std::endl;
+    if (buffer_bytes > 0) {
+        double removed = static_cast<double>(total_original_variation) - static_cast<double>(total_optimized_variation);
+        std::cout << "Jitter reduction per buffer byte: " << std::fixed << std::setprecision(2) << removed / buffer_bytes
+                  << " us/B" << std::endl;
+    }
+
 
     std::cout << "--- End Jitter Optimization Experiment ---" << std::endl << std::endl;
 }
\ No newline at end of file
@@ -8,7 +8,6 @@
 #include <string>
 #include <cstdint>
 #include <memory>
-#include <map>
 
 class INIReader;
 
@@ -28,10 +27,9 @@ private:
     int max_buffers_;
     uint64_t buffer_timeout_us_;
     int B_size_;
-
-
-    uint64_t calculateDelayVariation(const std::vector<uint64_t>& timestamps);
-    int countVariationFlows(const std::map<FlowKey<13>, std::vector<uint64_t>>& all_timestamps);
+    int threads_;       // optimizer threads, 0 = all cores
+    bool preempt_;
+    double preempt_margin_;
 };
 
 #endif // EXPERIMENT_JITTEREXPERIMENT_HH
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef EXPERIMENT_ONLINESHAPER_HH
+#define EXPERIMENT_ONLINESHAPER_HH
+
+#include "utils/core.hh"
+#include <memory>
+#include <vector>
+
+// Online OLDC: every flow is shaped as its packets arrive instead of in
+// hindsight once its buffer times out.
+//
+// The offline rule releases packet k at a_B + k * X_a, clamped to
+// [a_k, a_{k+2B}], with X_a the flow's mean gap over the whole buffer. The
+// online shaper decides each release when the packet arrives: the line is
+// a running least-squares fit of arrival time on packet index, plus B
+// fitted gaps of headroom but never more than buffer_timeout_us. Packets
+// before the B-th wait for it and are then scheduled together; one still
+// waiting buffer_timeout_us after it arrived goes out then. Releases
+// within a flow never reorder. The a_{k+2B} bound becomes a lookahead
+// rule: when packet k + 2B arrives, packet k and everything before it
+// still held go out at once. A flow keeps one fit for its whole life, so
+// it cannot anticipate a later change of rate. B_size and
+// buffer_timeout_us come from [JitterControlExperiment].
+//
+// Release times wait in a calendar queue. The run reports jitter reduction
+// with the control experiment's delay-variation metric, the mean added
+// delay, peak queue and held-packet counts, and the scheduling cost per
+// packet: the fastest of [OnlineShaper] reps passes with no metrics,
+// against the same passes on a binary heap.
+int runOnlineShaper(std::shared_ptr<INIReader> config, const std::vector<core::Record> &records);
+
+#endif // EXPERIMENT_ONLINESHAPER_HH
@@ -0,0 +1,188 @@
+#include "experiment/Replay.hh"
+#include "experiment/DetectorFactory.hh"
+#include "utils/BOBHash.hh"
+#include "utils/BroadcastRing.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace {
+
+    using clock = std::chrono::steady_clock;
+
+    struct ReplayResult {
+        double speedup = 0;
+        uint64_t offered = 0;
+        uint64_t dropped = 0;
+        size_t max_backlog = 0;
+        double mean_backlog = 0;
+        double max_late_us = 0;     // how far the pacer fell behind schedule
+
+        bool lossless() const { return dropped == 0; }
+    };
+
+    // Sleeps while the deadline is far off and yields for the last stretch:
+    // sleep_for overshoots by tens of microseconds.
+    void waitUntil(clock::time_point due) {
+        const auto coarse = std::chrono::microseconds(200);
+        auto now = clock::now();
+        if (due - now > coarse) {
+            std::this_thread::sleep_for(due - now - coarse / 2);
+        }
+        while (clock::now() < due) {
+            std::this_thread::yield();
+        }
+    }
+
+    template <typename sketch_t>
+    ReplayResult replay(sketch_t &sketch, const std::vector<core::Record> &records, double speedup,
+                        size_t queue_packets) {
+        core::BroadcastRing<core::Record> queue(queue_packets, 1);
+        sketch.clear();
+        sketch.setInitTime(records[0].timestamp_);
+        std::thread consumer([&]() {
+            while (const core::Record *record = queue.peek(0)) {
+                sketch.update(record->flowkey_, record->timestamp_);
+                queue.release(0);
+            }
+        });
+
+        ReplayResult result;
+        result.speedup = speedup;
+        uint64_t base = records[0].timestamp_;
+        double backlog_sum = 0;
+        auto start = clock::now();
+        for (const auto &record : records) {
+            uint64_t offset_us = record.timestamp_ > base ? record.timestamp_ - base : 0;
+            auto due = start + std::chrono::nanoseconds(static_cast<int64_t>(offset_us * 1000.0 / speedup));
+            auto now = clock::now();
+            if (now < due) {
+                waitUntil(due);
+            } else {
+                result.max_late_us = std::max(result.max_late_us,
+                                              std::chrono::duration<double, std::micro>(now - due).count());
+            }
+
+            ++result.offered;
+            core::Record *slot = queue.tryClaim();
+            if (!slot) {
+                ++result.dropped;
+                continue;
+            }
+            *slot = record;
+            queue.publish();
+            size_t backlog = queue.backlog();
+            result.max_backlog = std::max(result.max_backlog, backlog);
+            backlog_sum += backlog;
+        }
+        queue.close();
+        consumer.join();
+        uint64_t enqueued = result.offered - result.dropped;
+        result.mean_backlog = enqueued > 0 ? backlog_sum / enqueued : 0;
+        return result;
+    }
+
+    ReplayResult replayDetector(const std::string &name, const DetectorConfig &c,
+                                const std::vector<core::Record> &records, double speedup, size_t queue_packets) {
+        ReplayResult result;
+        // Same detector on every run, so runs differ only in pacing.
+        hash::AwareHash::reseed(hash::AwareHash::DEFAULT_SEED);
+        hash::BOBHash32::reseed(hash::AwareHash::DEFAULT_SEED);
+        withDetector(name, c, [&](auto &sketch) {
+            result = replay(sketch, records, speedup, queue_packets);
+        });
+        return result;
+    }
+
+    void printResult(const std::string &name, long mem_size, const ReplayResult &r, double trace_pps) {
+        printf(" %-18s mem %-9ld x%-9.4g offered %8.4f Mpps, dropped %llu (%.3f%%), queue max %zu mean %.1f, "
+               "pacer late max %.0f us\n",
+               name.c_str(), mem_size, r.speedup, trace_pps * r.speedup / 1e6,
+               static_cast<unsigned long long>(r.dropped), r.offered ? 100.0 * r.dropped / r.offered : 0,
+               r.max_backlog, r.mean_backlog, r.max_late_us);
+    }
+
+} // namespace
+
+int runReplay(std::shared_ptr<INIReader> config, const std::vector<core::Record> &records) {
+    if (records.size() < 2) {
+        printf("Replay: trace too short\n");
+        return 1;
+    }
+    std::vector<std::string> detectors = core::split_list(
+            config->Get("Replay", "detectors", "FDFilter,DelaySketch,JitterSketch,JitterSketchS1Opt"));
+    std::vector<std::string> mem_sizes = core::split_list(config->Get("Replay", "mem_size", ""));
+    std::vector<std::string> speedups = core::split_list(config->Get("Replay", "speedup", ""));
+    size_t queue_packets = static_cast<size_t>(config->GetInteger("Replay", "queue_packets", 4096));
+    bool search = config->GetBoolean("Replay", "search", true);
+    double search_min = config->GetReal("Replay", "search_min_speedup", 1.0);
+    double search_max = config->GetReal("Replay", "search_max_speedup", 1e6);
+    int search_steps = config->GetInteger("Replay", "search_steps", 6);
+    if (queue_packets == 0 || search_min <= 0) {
+        printf("Replay: need queue_packets > 0 and search_min_speedup > 0\n");
+        return 1;
+    }
+
+    DetectorConfig base = DetectorConfig::load(config);
+    if (mem_sizes.empty()) {
+        mem_sizes.push_back(std::to_string(base.mem_size));
+    }
+    double span = (records.back().timestamp_ - records.front().timestamp_) / 1e6;
+    double trace_pps = span > 0 ? records.size() / span : 0;
+    printf("--- Replay: %zu packets over %.2f s (%.4f Mpps at x1), %zu-packet ingest queue ---\n", records.size(),
+           span, trace_pps / 1e6, queue_packets);
+
+    for (const auto &name : detectors) {
+        if (!isDetectorName(name)) {
+            printf("Replay: unknown detector '%s'\n", name.c_str());
+            return 1;
+        }
+    }
+
+    for (const auto &name : detectors) {
+        for (const auto &mem : mem_sizes) {
+            DetectorConfig c = base;
+            c.mem_size = std::stol(mem);
+            ReplayResult probe;
+
+            for (const auto &speedup : speedups) {
+                printResult(name, c.mem_size, replayDetector(name, c, records, std::stod(speedup), queue_packets),
+                            trace_pps);
+            }
+            if (!search) {
+                continue;
+            }
+
+            // Double until a run drops, then bisect on a log scale.
+            double good = 0, bad = 0;
+            for (double s = search_min; s <= search_max; s *= 2) {
+                probe = replayDetector(name, c, records, s, queue_packets);
+                if (!probe.lossless()) {
+                    bad = s;
+                    break;
+                }
+                good = s;
+            }
+            if (good > 0 && bad > 0) {
+                for (int step = 0; step < search_steps; ++step) {
+                    double mid = std::sqrt(good * bad);
+                    probe = replayDetector(name, c, records, mid, queue_packets);
+                    (probe.lossless() ? good : bad) = mid;
+                }
+            }
+            if (good == 0) {
+                printf(" %-18s mem %-9ld drops already at x%g\n", name.c_str(), c.mem_size, search_min);
+            } else if (bad == 0) {
+                printf(" %-18s mem %-9ld lossless up to x%g (search limit)\n", name.c_str(), c.mem_size, good);
+            } else {
+                printf(" %-18s mem %-9ld break-even x%.4g = %.4f Mpps\n", name.c_str(), c.mem_size, good,
+                       trace_pps * good / 1e6);
+            }
+        }
+    }
+    printf("\n");
+    return 0;
+}
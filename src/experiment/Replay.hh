@@ -0,0 +1,23 @@
+#ifndef EXPERIMENT_REPLAY_HH
+#define EXPERIMENT_REPLAY_HH
+
+#include "utils/core.hh"
+#include <memory>
+#include <vector>
+
+// Real-time replay: packets are released at their trace timestamps, with
+// gaps divided by a speed-up factor. Each packet goes into a bounded ingest
+// queue ([Replay] queue_packets) that the detector drains on its own
+// thread, and a packet that finds the queue full is dropped, as a NIC ring
+// would drop it. Each run reports the offered rate, drops, queue occupancy
+// (maximum and mean at enqueue) and how late the pacer itself ran.
+//
+// Every value of speedup is replayed for every detector and mem_size.
+// With search = true, each (detector, mem_size) pair also gets a capacity
+// search. The speed-up doubles from search_min_speedup until a run drops
+// packets, then search_steps bisection steps narrow it down. The highest
+// lossless speed-up, and the packet rate it implies, is the break-even
+// rate.
+int runReplay(std::shared_ptr<INIReader> config, const std::vector<core::Record> &records);
+
+#endif // EXPERIMENT_REPLAY_HH
@@ -0,0 +1,201 @@
+#include "experiment/Sweep.hh"
+#include "experiment/DetectorFactory.hh"
+#include "experiment/EventMatcher.hh"
+#include "detector/GroundTruthDetector.hh"
+#include "utils/BOBHash.hh"
+#include "utils/WorkStealingPool.hh"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <tuple>
+
+namespace {
+
+    struct Axis {
+        const char *section;   // "sweep" for axes shared by every detector
+        const char *key;
+        void (*apply)(DetectorConfig &, double);
+    };
+
+    const Axis AXES[] = {
+        {"sweep", "mem_size", [](DetectorConfig &c, double v) { c.mem_size = static_cast<long>(v); }},
+        {"sweep", "jitter_factor", [](DetectorConfig &c, double v) { c.jitter_factor = v; }},
+        {"sweep", "frequency_threshold", [](DetectorConfig &c, double v) { c.frequency_threshold = static_cast<int>(v); }},
+        {"FDFilter", "ifpd_map_ratio", [](DetectorConfig &c, double v) { c.fd.ifpd_map_ratio = v; }},
+        {"FDFilter", "cm_sketch_ratio", [](DetectorConfig &c, double v) { c.fd.cm_sketch_ratio = v; }},
+        {"FDFilter", "cm_depth", [](DetectorConfig &c, double v) { c.fd.cm_depth = static_cast<int>(v); }},
+        {"FDFilter", "num_hash", [](DetectorConfig &c, double v) { c.fd.num_hash = static_cast<int>(v); }},
+        {"FDFilter", "gbf_max_fill", [](DetectorConfig &c, double v) { c.fd.gbf_max_fill = v; }},
+        {"DelaySketch", "d", [](DetectorConfig &c, double v) { c.ds.d = static_cast<int>(v); }},
+        {"DelaySketch", "ifpd_map_ratio", [](DetectorConfig &c, double v) { c.ds.ifpd_map_ratio = v; }},
+        {"DelaySketch", "cm_sketch_ratio", [](DetectorConfig &c, double v) { c.ds.cm_sketch_ratio = v; }},
+        {"DelaySketch", "cm_depth", [](DetectorConfig &c, double v) { c.ds.cm_depth = static_cast<int>(v); }},
+        {"JitterSketch", "stage_one_ratio", [](DetectorConfig &c, double v) { c.js.stage_one_ratio = v; }},
+        {"JitterSketch", "stage_two_ratio", [](DetectorConfig &c, double v) { c.js.stage_two_ratio = v; }},
+        {"JitterSketch", "d3", [](DetectorConfig &c, double v) { c.js.d3 = static_cast<int>(v); }},
+        {"JitterSketchS1Opt", "stage_one_ratio", [](DetectorConfig &c, double v) { c.s1opt.stage_one_ratio = v; }},
+        {"JitterSketchS1Opt", "stage_two_ratio", [](DetectorConfig &c, double v) { c.s1opt.stage_two_ratio = v; }},
+        {"JitterSketchS1Opt", "d3", [](DetectorConfig &c, double v) { c.s1opt.d3 = static_cast<int>(v); }},
+        {"JitterSketchS1Opt", "s1_hash_num", [](DetectorConfig &c, double v) { c.s1opt.s1_hash_num = static_cast<int>(v); }},
+    };
+
+    struct Job {
+        std::string detector;
+        DetectorConfig config;
+        uint64_t seed;
+        std::string params;    // detector-specific axis values
+        size_t truth;          // index into the ground-truth sets
+    };
+
+    struct JobResult {
+        bool ok = false;
+        size_t bytes = 0;
+        MatchCounts counts;
+        double mpps = 0;
+    };
+
+    using TruthKey = std::tuple<double, uint64_t, uint64_t, int, int>;
+
+    std::vector<Job> buildJobs(const DetectorConfig &base, std::shared_ptr<INIReader> grid) {
+        std::vector<std::string> detectors = core::split_list(
+                grid->Get("sweep", "detectors", "FDFilter,DelaySketch,JitterSketch,JitterSketchS1Opt"));
+        std::vector<std::string> seeds = core::split_list(grid->Get("sweep", "seed", ""));
+        if (seeds.empty()) {
+            seeds.push_back(std::to_string(hash::AwareHash::DEFAULT_SEED));
+        }
+
+        std::vector<Job> jobs;
+        for (const auto &detector : detectors) {
+            std::vector<const Axis *> axes;
+            std::vector<std::vector<std::string>> values;
+            for (const Axis &axis : AXES) {
+                if (detector != axis.section && std::string("sweep") != axis.section) {
+                    continue;
+                }
+                std::vector<std::string> list = core::split_list(grid->Get(axis.section, axis.key, ""));
+                if (!list.empty()) {
+                    axes.push_back(&axis);
+                    values.push_back(list);
+                }
+            }
+
+            // Odometer over the axes, innermost last; seeds innermost.
+            std::vector<size_t> pos(axes.size(), 0);
+            while (true) {
+                Job job;
+                job.detector = detector;
+                job.config = base;
+                for (size_t a = 0; a < axes.size(); ++a) {
+                    axes[a]->apply(job.config, std::stod(values[a][pos[a]]));
+                    if (std::string("sweep") != axes[a]->section) {
+                        job.params += (job.params.empty() ? "" : ";") + std::string(axes[a]->key) + "=" + values[a][pos[a]];
+                    }
+                }
+                for (const auto &seed : seeds) {
+                    job.seed = std::stoull(seed);
+                    jobs.push_back(job);
+                }
+
+                size_t a = axes.size();
+                while (a > 0 && ++pos[a - 1] == values[a - 1].size()) {
+                    pos[--a] = 0;
+                }
+                if (a == 0) {
+                    break;
+                }
+            }
+        }
+        return jobs;
+    }
+
+    template <typename sketch_t>
+    void evaluate(sketch_t &sketch, const std::vector<core::Record> &records,
+                  const std::vector<GroundTruthDetector::Event> &truth, JobResult &result) {
+        sketch.clear();
+        sketch.setInitTime(records[0].timestamp_);
+        auto start = std::chrono::steady_clock::now();
+        sketch.updateBatch(records.data(), records.size());
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+
+        result.mpps = seconds > 0 ? records.size() / seconds / 1e6 : 0;
+        result.bytes = sketch.size();
+        result.counts = EventMatcher::match(sketch.getAbnormalEvents(), truth, EventMatcher::DEFAULT_TIME_THRESHOLD,
+                                            0, EventMatcher::DEFAULT_IFPD_THRESHOLD, 1);
+        result.ok = true;
+    }
+
+} // namespace
+
+int runSweep(std::shared_ptr<INIReader> config, std::shared_ptr<INIReader> grid,
+             const std::vector<core::Record> &records) {
+    if (records.empty()) {
+        printf("Sweep: empty trace\n");
+        return 1;
+    }
+    DetectorConfig base = DetectorConfig::load(config);
+    std::vector<Job> jobs = buildJobs(base, grid);
+    std::string output = grid->Get("sweep", "output", "sweep.csv");
+    unsigned threads = static_cast<unsigned>(grid->GetInteger("sweep", "threads", 0));
+
+    // One ground truth per distinct set of detection parameters.
+    std::map<TruthKey, size_t> truth_index;
+    std::vector<std::vector<GroundTruthDetector::Event>> truths;
+    GroundTruthOptions truth_options = GroundTruthOptions::load(config);
+    for (auto &job : jobs) {
+        const DetectorConfig &c = job.config;
+        TruthKey key(c.jitter_factor, c.min_absolute_jitter_thres, c.max_ifpd_diff, c.jitter_detection_mode,
+                     c.frequency_threshold);
+        auto it = truth_index.find(key);
+        if (it == truth_index.end()) {
+            GroundTruthDetector truth(c.jitter_factor, c.min_absolute_jitter_thres, c.max_ifpd_diff,
+                                      c.jitter_detection_mode, c.frequency_threshold);
+            truth.run(records, truth_options);
+            it = truth_index.emplace(key, truths.size()).first;
+            truths.push_back(truth.getAbnormalEvents());
+        }
+        job.truth = it->second;
+    }
+
+    core::WorkStealingPool pool(threads);
+    printf("Sweep: %zu jobs, %zu ground-truth sets, %u threads\n", jobs.size(), truths.size(), pool.size());
+
+    std::vector<JobResult> results(jobs.size());
+    auto start = std::chrono::steady_clock::now();
+    pool.run(jobs.size(), [&](size_t i) {
+        const Job &job = jobs[i];
+        hash::AwareHash::reseed(job.seed);
+        hash::BOBHash32::reseed(static_cast<uint32_t>(job.seed));
+        withDetector(job.detector, job.config, [&](auto &sketch) {
+            evaluate(sketch, records, truths[job.truth], results[i]);
+        });
+    });
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FILE *out = fopen(output.c_str(), "w");
+    if (!out) {
+        printf("Sweep: can't write '%s'\n", output.c_str());
+        return 1;
+    }
+    fprintf(out, "job,detector,seed,mem_size,jitter_factor,frequency_threshold,params,bytes,tp,fp,fn,precision,recall,f1,mpps\n");
+    size_t failed = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const Job &job = jobs[i];
+        const JobResult &r = results[i];
+        if (!r.ok) {
+            printf("Sweep: unknown detector '%s'\n", job.detector.c_str());
+            ++failed;
+            continue;
+        }
+        fprintf(out, "%zu,%s,%llu,%ld,%g,%d,\"%s\",%zu,%llu,%llu,%llu,%.6f,%.6f,%.6f,%.4f\n", i, job.detector.c_str(),
+                static_cast<unsigned long long>(job.seed), job.config.mem_size, job.config.jitter_factor,
+                job.config.frequency_threshold, job.params.c_str(), r.bytes,
+                static_cast<unsigned long long>(r.counts.tp), static_cast<unsigned long long>(r.counts.fp),
+                static_cast<unsigned long long>(r.counts.fn), r.counts.precision(), r.counts.recall(), r.counts.f1(),
+                r.mpps);
+    }
+    fclose(out);
+    printf("Sweep: %zu jobs in %.2f s, results in %s\n", jobs.size() - failed, elapsed, output.c_str());
+    return failed ? 1 : 0;
+}
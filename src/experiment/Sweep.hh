@@ -0,0 +1,24 @@
+#ifndef EXPERIMENT_SWEEP_HH
+#define EXPERIMENT_SWEEP_HH
+
+#include "utils/core.hh"
+#include <memory>
+#include <vector>
+
+// Parameter sweep over one in-memory trace.
+//
+// The grid file lists comma-separated values per axis. [sweep] holds the
+// shared axes (detectors, mem_size, jitter_factor, frequency_threshold,
+// seed) plus output and threads; a section named after a detector holds
+// that detector's axes (ratios, d3, d, ...; see Sweep.cc for the list).
+// Axes not in the grid keep their settings.conf value. Every detector is
+// run on the cartesian product of its axes; all jobs share the read-only
+// records and run on a work-stealing pool. Ground truth is computed once
+// per distinct set of detection parameters. One CSV row per job is
+// written to output, in job order. With more than one thread the Mpps
+// column reflects a loaded machine; use threads = 1 for throughput
+// numbers.
+int runSweep(std::shared_ptr<INIReader> config, std::shared_ptr<INIReader> grid,
+             const std::vector<core::Record> &records);
+
+#endif // EXPERIMENT_SWEEP_HH
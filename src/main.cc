@@ -3,6 +3,10 @@
 #include "experiment/JitterControlExperiment.hh"
 #include "optimizer/OLDCOptimizer.hh"
 #include "optimizer/JitterSketchOptimizer.hh"
+#include "experiment/Sweep.hh"
+#include "experiment/FanOut.hh"
+#include "experiment/Replay.hh"
+#include "experiment/OnlineShaper.hh"
 #include <string>
 #include <memory>
 #include <algorithm>
@@ -24,7 +28,7 @@ int main(int argc, char *argv[]) {
     printf("Successfully loaded config file: %s\n\n", config_file.c_str());
 
     std::string data_file = config->Get("general", "data_file", "");
-    auto records = core::load_records(data_file);
+    auto records = core::load_records(data_file, config->GetBoolean("general", "shuffle_flow_keys", true));
 
     long mem_size = config->GetInteger("general", "mem_size", 0);
 
@@ -34,6 +38,31 @@ int main(int argc, char *argv[]) {
                    [](auto &record) { return record.flowkey_; });
     printf("Flow number is %ld\n", s.size());
 
+    // ./main settings.conf --sweep sweep.conf
+    if (argc > 3 && std::string(argv[2]) == "--sweep") {
+        auto grid = core::load_settings(argv[3]);
+        if (!grid || grid->ParseError() < 0) {
+            printf("Can't load sweep grid '%s'.\n", argv[3]);
+            return 1;
+        }
+        return runSweep(config, grid, records);
+    }
+
+    // ./main settings.conf --fanout
+    if (argc > 2 && std::string(argv[2]) == "--fanout") {
+        return runFanOut(config, records);
+    }
+
+    // ./main settings.conf --replay
+    if (argc > 2 && std::string(argv[2]) == "--replay") {
+        return runReplay(config, records);
+    }
+
+    // ./main settings.conf --online
+    if (argc > 2 && std::string(argv[2]) == "--online") {
+        return runOnlineShaper(config, records);
+    }
+
     printf("\n\n###########################################################\n");
     printf("#####         STARTING JITTER DETECT EXPERIMENT       #####\n");
     printf("###########################################################\n\n");
@@ -1,12 +1,35 @@
 #ifndef OPTIMIZER_JITTEROPTIMIZER_HH
 #define OPTIMIZER_JITTEROPTIMIZER_HH
 
+#include <algorithm>
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <string>
 
 class INIReader;
 
+namespace core {
+    class WorkStealingPool;
+}
+
+// Arrival times of many flows back to back: flow f is
+// times[offsets[f], offsets[f + 1]).
+struct FlowBatch {
+    std::vector<uint64_t> times;
+    std::vector<size_t> offsets{0};
+
+    size_t flows() const { return offsets.size() - 1; }
+
+    void clear() {
+        times.clear();
+        offsets.assign(1, 0);
+    }
+
+    // Ends the flow whose times were appended since the last call.
+    void close() { offsets.push_back(times.size()); }
+};
+
 class JitterOptimizer {
 public:
     virtual ~JitterOptimizer() = default;
@@ -15,7 +38,22 @@ public:
 
     virtual std::vector<uint64_t> optimize(const std::vector<uint64_t>& arrival_times) = 0;
 
+    // Release times for every flow of the batch, laid out like
+    // batch.times and identical to optimize() on each flow alone. The pool,
+    // if any, may be used to spread flows over threads; this default runs
+    // optimize() flow by flow on the calling thread.
+    virtual void optimizeMany(const FlowBatch& batch, std::vector<uint64_t>& release_times,
+                              core::WorkStealingPool* /*pool*/ = nullptr) {
+        release_times.resize(batch.times.size());
+        std::vector<uint64_t> arrival_times;
+        for (size_t f = 0; f < batch.flows(); ++f) {
+            arrival_times.assign(batch.times.begin() + batch.offsets[f], batch.times.begin() + batch.offsets[f + 1]);
+            std::vector<uint64_t> released = optimize(arrival_times);
+            std::copy(released.begin(), released.end(), release_times.begin() + batch.offsets[f]);
+        }
+    }
+
     virtual std::string name() const = 0;
 };
 
-#endif // OPTIMIZER_JITTEROPTIMIZER_HH
\ No newline at end of file
+#endif // OPTIMIZER_JITTEROPTIMIZER_HH
@@ -1,7 +1,9 @@
 #include "JitterSketchOptimizer.hh"
+#include "OLDCKernel.hh"
 #include "utils/INIReader.h"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
-#include <limits>
 #include <iostream>
 
 JitterSketchOptimizer::JitterSketchOptimizer() : B_(0) {}
@@ -39,57 +41,59 @@ void JitterSketchOptimizer::configure(std::shared_ptr<INIReader> config) {
         w3 = s3_mem_bytes / (d3 * s3_entry_size);
     }
     dj_sketch_ = std::make_unique<sketch::JitterSketch<hash::AwareHash>>(w1, w2, w3, d3, jitter_factor, min_absolute_jitter_thres, max_ifpd_diff, jitter_detection_mode, frequency_threshold);
+
+    long jittered_flows = config->GetInteger("DJSketchOptimizer", "jittered_flows", 8192);
+    long jitter_ttl_us = config->GetInteger("DJSketchOptimizer", "jitter_ttl_us", 0);
+    jittered_flows_ = std::make_unique<JitteredFlowTable>(jittered_flows > 0 ? jittered_flows : 1, jitter_ttl_us > 0 ? jitter_ttl_us : 0);
 }
 
 std::string JitterSketchOptimizer::name() const {
     return "JitterSketch Opt";
 }
 
-void JitterSketchOptimizer::processPacket(const FlowKey<13>& flowkey, uint64_t timestamp) {
-    if (dj_sketch_) {
-        dj_sketch_->update(flowkey, timestamp);
-        const auto& abnormal_events = dj_sketch_->getAbnormalEvents();
-        if (!abnormal_events.empty()) {
-            const auto& last_event = abnormal_events.back();
-            if (std::get<0>(last_event) == flowkey) {
-                jittered_flows_.insert(flowkey);
-            }
-        }
+bool JitterSketchOptimizer::processPacket(const FlowKey<13>& flowkey, uint64_t timestamp) {
+    if (!dj_sketch_) {
+        return false;
+    }
+    const auto& abnormal_events = dj_sketch_->getAbnormalEvents();
+    size_t events = abnormal_events.size();
+    dj_sketch_->update(flowkey, timestamp);
+    // Only an event raised by this packet renews the flow's entry. Each
+    // event adds log2 of its IFPD ratio to the flow's severity, so both
+    // how often and how sharply a flow jitters count, and one event
+    // against a near-zero IFPD does not outweigh many.
+    if (abnormal_events.size() == events) {
+        return false;
     }
+    uint64_t old_ifpd = std::get<1>(abnormal_events.back());
+    uint64_t esti_delay = std::get<2>(abnormal_events.back());
+    uint64_t lo = std::max<uint64_t>(1, std::min(old_ifpd, esti_delay));
+    uint64_t hi = std::max(old_ifpd, esti_delay);
+    jittered_flows_->mark(flowkey, timestamp, static_cast<float>(std::log2(static_cast<double>(hi) / lo)));
+    return true;
 }
 
-bool JitterSketchOptimizer::hasJitter(const FlowKey<13>& flowkey) {
-    return jittered_flows_.count(flowkey) > 0;
+bool JitterSketchOptimizer::hasJitter(const FlowKey<13>& flowkey, uint64_t timestamp) const {
+    return jittered_flows_ && jittered_flows_->contains(flowkey, timestamp);
 }
 
-void JitterSketchOptimizer::clearJitteredFlows() {
-    jittered_flows_.clear();
+float JitterSketchOptimizer::severity(const FlowKey<13>& flowkey, uint64_t timestamp) const {
+    return jittered_flows_ ? jittered_flows_->severity(flowkey, timestamp) : 0.0f;
 }
 
-std::vector<uint64_t> JitterSketchOptimizer::optimize(const std::vector<uint64_t>& arrival_times) {
-    size_t n = arrival_times.size();
-
-    if (n <= static_cast<size_t>(2 * B_)) {
-        return arrival_times;
+void JitterSketchOptimizer::clearJitteredFlows() {
+    if (jittered_flows_) {
+        jittered_flows_->clear();
     }
+}
 
-    std::vector<uint64_t> release_times(n);
-    double X_a = static_cast<double>(arrival_times.back() - arrival_times.front()) / (n - 1);
-    uint64_t a_B = arrival_times[B_];
-
-    for (size_t k = 0; k < n; ++k) {
-        uint64_t s_on_star_k = a_B + static_cast<uint64_t>((double)k * X_a);
-        uint64_t a_k = arrival_times[k];
-        uint64_t a_k_plus_2B = (k + 2 * B_ < n) ? arrival_times[k + 2 * B_] : std::numeric_limits<uint64_t>::max();
-
-        uint64_t s_on_k = s_on_star_k;
-        if (s_on_k < a_k) {
-            s_on_k = a_k;
-        }
-        if (s_on_k > a_k_plus_2B) {
-            s_on_k = a_k_plus_2B;
-        }
-        release_times[k] = s_on_k;
-    }
+std::vector<uint64_t> JitterSketchOptimizer::optimize(const std::vector<uint64_t>& arrival_times) {
+    std::vector<uint64_t> release_times(arrival_times.size());
+    oldc::release(arrival_times.data(), arrival_times.size(), B_, release_times.data());
     return release_times;
-}
\ No newline at end of file
+}
+
+void JitterSketchOptimizer::optimizeMany(const FlowBatch& batch, std::vector<uint64_t>& release_times,
+                                         core::WorkStealingPool* pool) {
+    oldc::releaseMany(batch, B_, release_times, pool);
+}
@@ -4,9 +4,9 @@
 #define OPTIMIZER_DJSKETCHOPTIMIZER_HH
 
 #include "JitterOptimizer.hh"
+#include "JitteredFlowTable.hh"
 #include "sketch/JitterSketch.hh"
 #include "utils/hash.hh"
-#include <set>
 #include <memory>
 
 class JitterSketchOptimizer : public JitterOptimizer {
@@ -17,18 +17,27 @@ public:
 
     std::vector<uint64_t> optimize(const std::vector<uint64_t>& arrival_times) override;
 
+    void optimizeMany(const FlowBatch& batch, std::vector<uint64_t>& release_times,
+                      core::WorkStealingPool* pool = nullptr) override;
+
     std::string name() const override;
 
-    void processPacket(const FlowKey<13>& flowkey, uint64_t timestamp);
+    // Feeds the packet to the sketch; true when it raised a jitter event.
+    bool processPacket(const FlowKey<13>& flowkey, uint64_t timestamp);
+
+    // Whether the flow was marked jittered, within the last jitter_ttl_us
+    // when one is set.
+    bool hasJitter(const FlowKey<13>& flowkey, uint64_t timestamp) const;
 
-    bool hasJitter(const FlowKey<13>& flowkey);
+    // Accumulated severity of a flow that hasJitter(), otherwise 0.
+    float severity(const FlowKey<13>& flowkey, uint64_t timestamp) const;
 
     void clearJitteredFlows();
 
 private:
     int B_;
     std::unique_ptr<sketch::JitterSketch<hash::AwareHash>> dj_sketch_;
-    std::set<FlowKey<13>> jittered_flows_;
+    std::unique_ptr<JitteredFlowTable> jittered_flows_;
 };
 
 #endif
\ No newline at end of file
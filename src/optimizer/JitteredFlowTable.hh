@@ -0,0 +1,153 @@
+#ifndef OPTIMIZER_JITTEREDFLOWTABLE_HH
+#define OPTIMIZER_JITTEREDFLOWTABLE_HH
+
+#include "utils/aligned.hh"
+#include "utils/flowkey.hh"
+#include "utils/hash.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// One cache line of the table: eight 32-bit flow fingerprints and the tick
+// each one expires at. fp == 0 is empty.
+struct alignas(core::CACHE_LINE_SIZE) JitteredFlowBucket {
+    static constexpr int SLOTS = 8;
+    uint32_t fp[SLOTS];
+    uint32_t expiry[SLOTS];
+};
+static_assert(sizeof(JitteredFlowBucket) == core::CACHE_LINE_SIZE, "JitteredFlowBucket must fill one cache line");
+
+// Flows seen jittering: a fixed set-associative table of fingerprints,
+// each kept for ttl_us after its flow was last marked, or until it is
+// evicted when ttl_us is 0.
+//
+// A flow maps to a single bucket, so contains() reads one cache line. A
+// mark() that finds the bucket full evicts the entry closest to expiry
+// (an expired one if there is any; the least recently marked one without
+// a TTL), and memory never grows. Times are kept in ticks of 2^TICK_SHIFT
+// us, compared modulo 2^32, so TTLs are capped at 2^31 - 1 ticks (about
+// 25 days) and an entry left untouched longer than that could look live
+// again; expiries are rounded up to whole ticks. Fingerprints can collide,
+// making a flow look jittered once in about 2^29 lookups.
+//
+// Each entry also accumulates a severity score from the weights its marks
+// carry, restarting when the entry is new or had expired. Scores sit in a
+// separate array, so contains() still reads only the bucket.
+class JitteredFlowTable {
+public:
+    static constexpr int TICK_SHIFT = 10;
+
+    // ttl_us == 0 keeps entries until they are evicted.
+    JitteredFlowTable(size_t num_entries, uint64_t ttl_us)
+            : num_buckets_(static_cast<uint32_t>(std::max<size_t>(1, (num_entries + JitteredFlowBucket::SLOTS - 1) / JitteredFlowBucket::SLOTS))),
+              ttl_ticks_(toTicks(ttl_us)),
+              buckets_(num_buckets_), scores_(static_cast<size_t>(num_buckets_) * JitteredFlowBucket::SLOTS) {}
+
+    // Marks the flow as jittered at timestamp, or renews its entry, and
+    // adds weight to its severity.
+    void mark(const FlowKey<13>& flowkey, uint64_t timestamp, float weight) {
+        uint32_t fp;
+        uint32_t b = locate(flowkey, fp);
+        JitteredFlowBucket& bucket = buckets_[b];
+        uint32_t now = tick(timestamp);
+        int victim = 0;
+        for (int i = 0; i < JitteredFlowBucket::SLOTS; ++i) {
+            if (bucket.fp[i] == fp) {
+                victim = i;
+                break;
+            }
+            if (left(bucket, i, now) < left(bucket, victim, now)) {
+                victim = i;
+            }
+        }
+        float& score = scores_[b * JitteredFlowBucket::SLOTS + victim];
+        if (bucket.fp[victim] == fp && live(bucket, victim, now)) {
+            score += weight;
+        } else {
+            if (live(bucket, victim, now)) {
+                ++evictions_;
+            }
+            score = weight;
+        }
+        bucket.fp[victim] = fp;
+        bucket.expiry[victim] = now + (ttl_ticks_ != 0 ? ttl_ticks_ : toTicks(UINT64_MAX));
+    }
+
+    bool contains(const FlowKey<13>& flowkey, uint64_t timestamp) const {
+        uint32_t fp;
+        const JitteredFlowBucket& bucket = buckets_[locate(flowkey, fp)];
+        uint32_t now = tick(timestamp);
+        for (int i = 0; i < JitteredFlowBucket::SLOTS; ++i) {
+            if (bucket.fp[i] == fp) {
+                return live(bucket, i, now);
+            }
+        }
+        return false;
+    }
+
+    // Severity of a live entry, 0 for a flow not in the table.
+    float severity(const FlowKey<13>& flowkey, uint64_t timestamp) const {
+        uint32_t fp;
+        uint32_t b = locate(flowkey, fp);
+        const JitteredFlowBucket& bucket = buckets_[b];
+        uint32_t now = tick(timestamp);
+        for (int i = 0; i < JitteredFlowBucket::SLOTS; ++i) {
+            if (bucket.fp[i] == fp) {
+                return live(bucket, i, now) ? scores_[b * JitteredFlowBucket::SLOTS + i] : 0.0f;
+            }
+        }
+        return 0.0f;
+    }
+
+    void clear() {
+        buckets_.zero();
+        std::fill(scores_.begin(), scores_.end(), 0.0f);
+        evictions_ = 0;
+    }
+
+    size_t size() const { return buckets_.bytes(); }
+
+    // Live entries pushed out by a full bucket.
+    uint64_t evictions() const { return evictions_; }
+
+private:
+    uint32_t num_buckets_;
+    uint32_t ttl_ticks_;
+    core::AlignedArray<JitteredFlowBucket> buckets_;
+    std::vector<float> scores_;
+    uint64_t evictions_ = 0;
+
+    static uint32_t tick(uint64_t timestamp) { return static_cast<uint32_t>(timestamp >> TICK_SHIFT); }
+
+    // TTL in whole ticks, capped at 2^31 - 1 so expiries still compare
+    // correctly modulo 2^32; 0 stays 0 (no expiry).
+    static uint32_t toTicks(uint64_t ttl_us) {
+        const uint64_t max_ticks = static_cast<uint64_t>(std::numeric_limits<int32_t>::max());
+        uint64_t ticks = (ttl_us >> TICK_SHIFT) + ((ttl_us & ((1u << TICK_SHIFT) - 1)) != 0);
+        return static_cast<uint32_t>(ticks < max_ticks ? ticks : max_ticks);
+    }
+
+    // Ticks until slot i expires; zero or less once it has, and for an
+    // empty slot.
+    static int32_t left(const JitteredFlowBucket& bucket, int i, uint32_t now) {
+        return bucket.fp[i] == 0 ? std::numeric_limits<int32_t>::min() : static_cast<int32_t>(bucket.expiry[i] - now);
+    }
+
+    bool live(const JitteredFlowBucket& bucket, int i, uint32_t now) const {
+        return bucket.fp[i] != 0 && (ttl_ticks_ == 0 || left(bucket, i, now) > 0);
+    }
+
+    // Bucket of the flow; its fingerprint goes to fp.
+    uint32_t locate(const FlowKey<13>& flowkey, uint32_t& fp) const {
+        uint64_t h = hash::FlowKeyHash()(flowkey);
+        fp = static_cast<uint32_t>(h >> 32);
+        if (fp == 0) {
+            fp = 1;
+        }
+        return core::FastRange32(static_cast<uint32_t>(h), num_buckets_);
+    }
+};
+
+#endif // OPTIMIZER_JITTEREDFLOWTABLE_HH
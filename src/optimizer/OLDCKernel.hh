@@ -0,0 +1,103 @@
+#ifndef OPTIMIZER_OLDCKERNEL_HH
+#define OPTIMIZER_OLDCKERNEL_HH
+
+#include "JitterOptimizer.hh"
+#include "utils/WorkStealingPool.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// The OLDC release rule shared by OLDCOptimizer and JitterSketchOptimizer:
+// packet k of a buffer of n goes out at a_B + floor(k * X_a), clamped to
+// [a_k, a_{k+2B}], with X_a = (a_{n-1} - a_0) / (n - 1). Buffers of at most
+// 2B packets go out as they arrived.
+namespace oldc {
+
+    // Packets per pool task in releaseMany(); smaller batches run inline.
+    constexpr size_t TASK_PACKETS = 16384;
+
+    inline void release(const uint64_t *a, size_t n, int B, uint64_t *out) {
+        size_t span = 2 * static_cast<size_t>(B);
+        if (n <= span) {
+            std::copy(a, a + n, out);
+            return;
+        }
+        double X_a = static_cast<double>(a[n - 1] - a[0]) / (n - 1);
+        uint64_t a_B = a[B];
+        size_t bounded = n - span;  // packets that have an a_{k+2B}
+        size_t k = 0;
+#ifdef __AVX2__
+        // AVX2 has no double to uint64 conversion: k * X_a is truncated in
+        // double and moved to integer through the 2^52 mantissa trick,
+        // which is exact below 2^52. Offsets only grow with k, so the first
+        // group at or past that goes to the scalar loop with the rest.
+        // Unsigned compares flip the sign bit of both sides.
+        const __m256d two52 = _mm256_set1_pd(4503599627370496.0);
+        const __m256i two52_bits = _mm256_castpd_si256(two52);
+        const __m256i sign = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+        const __m256i base = _mm256_set1_epi64x(static_cast<int64_t>(a_B));
+        const __m256d step = _mm256_set1_pd(X_a);
+        const __m256d four = _mm256_set1_pd(4.0);
+        __m256d index = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+        for (; k + 4 <= bounded; k += 4, index = _mm256_add_pd(index, four)) {
+            __m256d offset = _mm256_round_pd(_mm256_mul_pd(index, step), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+            if (_mm256_movemask_pd(_mm256_cmp_pd(offset, two52, _CMP_GE_OQ))) {
+                break;
+            }
+            __m256i s = _mm256_add_epi64(
+                    base, _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(offset, two52)), two52_bits));
+            __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + k));
+            __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + k + span));
+            __m256i s_flipped = _mm256_xor_si256(s, sign);
+            __m256i below = _mm256_cmpgt_epi64(_mm256_xor_si256(lo, sign), s_flipped);
+            s = _mm256_blendv_epi8(s, lo, below);
+            __m256i above = _mm256_cmpgt_epi64(_mm256_xor_si256(s, sign), _mm256_xor_si256(hi, sign));
+            s = _mm256_blendv_epi8(s, hi, above);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + k), s);
+        }
+#endif
+        for (; k < n; ++k) {
+            uint64_t s = a_B + static_cast<uint64_t>(static_cast<double>(k) * X_a);
+            if (s < a[k]) {
+                s = a[k];
+            }
+            if (k < bounded && s > a[k + span]) {
+                s = a[k + span];
+            }
+            out[k] = s;
+        }
+    }
+
+    // release() over every flow of a batch, into out laid out like
+    // batch.times. With a pool, flows are split into tasks of about
+    // TASK_PACKETS packets; flows never share an output element, so the
+    // result does not depend on how they are split.
+    inline void releaseMany(const FlowBatch &batch, int B, std::vector<uint64_t> &out, core::WorkStealingPool *pool) {
+        out.resize(batch.times.size());
+        auto run = [&](size_t first, size_t last) {
+            for (size_t f = first; f < last; ++f) {
+                size_t begin = batch.offsets[f];
+                release(batch.times.data() + begin, batch.offsets[f + 1] - begin, B, out.data() + begin);
+            }
+        };
+        if (!pool || pool->size() < 2 || batch.times.size() < 2 * TASK_PACKETS) {
+            run(0, batch.flows());
+            return;
+        }
+        std::vector<size_t> tasks{0};
+        for (size_t f = 1; f <= batch.flows(); ++f) {
+            if (batch.offsets[f] - batch.offsets[tasks.back()] >= TASK_PACKETS || f == batch.flows()) {
+                tasks.push_back(f);
+            }
+        }
+        pool->run(tasks.size() - 1, [&](size_t t) { run(tasks[t], tasks[t + 1]); });
+    }
+
+} // namespace oldc
+
+#endif // OPTIMIZER_OLDCKERNEL_HH
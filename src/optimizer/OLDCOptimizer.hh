@@ -11,6 +11,9 @@ public:
 
     std::vector<uint64_t> optimize(const std::vector<uint64_t>& arrival_times) override;
 
+    void optimizeMany(const FlowBatch& batch, std::vector<uint64_t>& release_times,
+                      core::WorkStealingPool* pool = nullptr) override;
+
     std::string name() const override;
 
 private:
@@ -0,0 +1,206 @@
+#ifndef SKETCH_BLOCKEDBITBF_HH
+#define SKETCH_BLOCKEDBITBF_HH
+
+#include "utils/flowkey.hh"
+#include "utils/aligned.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace sketch {
+
+    // All windows of FDFilter's BitBf sequence in one blocked Bloom filter.
+    //
+    // A key's single hash selects one 64-byte line. The line is cut into
+    // cells of W = windows * planes bits, one bit per (window, bit-plane)
+    // pair, so the W independent Bloom filters of the old BitBf/BloomFilter
+    // stack are interleaved cell by cell. The key's num_hash positions are
+    // cells of that line; ANDing them yields the membership bit of every
+    // plane of every window at once, so a whole BitBf query sequence costs
+    // one memory access.
+    //
+    // Windows form a ring: logical window 0 is the oldest, windows - 1 the
+    // newest. rotate() only advances the head and a rotation counter. The
+    // recycled window is cleared lazily: the top 32 bits of every line hold
+    // the rotation count the line was last brought up to date with, and a
+    // line that is behind has the bits of the windows recycled since then
+    // masked out the next time a key touches it. Rollover is O(1) and the
+    // clearing cost is spread over later packets. (A line left untouched for
+    // exactly 2^32 rotations would be seen as current.)
+    //
+    // WINDOWS, PLANES and NUM_HASH fix the geometry at compile time so the
+    // cell width, cell count and hash loop become constants; 0 (the default)
+    // takes the value from the constructor instead.
+    template <typename hash_t, int WINDOWS = 0, int PLANES = 0, int NUM_HASH = 0>
+    class BlockedBitBf {
+    public:
+        static constexpr int LINE_BITS = core::CACHE_LINE_SIZE * 8;
+        static constexpr int DATA_BITS = LINE_BITS - 32;
+        static constexpr int MAX_HASH = 16;
+        static_assert(WINDOWS * PLANES <= 64, "a cell must fit in 64 bits");
+        static_assert(NUM_HASH <= MAX_HASH, "too many hash positions");
+
+        struct alignas(core::CACHE_LINE_SIZE) Line {
+            uint64_t words[LINE_BITS / 64];
+        };
+
+        // Line and cell positions of one key, computed once per packet.
+        struct Probe {
+            uint32_t line;
+            uint16_t bit[MAX_HASH];
+        };
+
+    private:
+        int windows_;
+        int planes_;
+        int width_;          // bits per cell
+        int cells_;          // cells per line
+        int num_hash_;
+        int head_;           // physical slot of logical window 0
+        uint32_t rotations_;
+        uint32_t num_lines_;
+        uint64_t cell_mask_;
+        uint64_t plane_mask_;
+        core::AlignedArray<Line> lines_;
+        core::AlignedArray<Line> slot_masks_;  // bits of each physical slot
+        hash_t hash_fn_;
+
+        static constexpr int LAST_WORD = LINE_BITS / 64 - 1;
+
+        inline int windows() const { return WINDOWS ? WINDOWS : windows_; }
+        inline int planes() const { return PLANES ? PLANES : planes_; }
+        inline int width() const { return (WINDOWS && PLANES) ? WINDOWS * PLANES : width_; }
+        inline int cells() const { return (WINDOWS && PLANES) ? DATA_BITS / (WINDOWS * PLANES) : cells_; }
+        inline int numHash() const { return NUM_HASH ? NUM_HASH : num_hash_; }
+        inline uint64_t cellMask() const {
+            return (WINDOWS && PLANES) ? (WINDOWS * PLANES >= 64 ? ~0ULL : (1ULL << (WINDOWS * PLANES)) - 1) : cell_mask_;
+        }
+        inline uint64_t planeMask() const { return PLANES ? (1ULL << PLANES) - 1 : plane_mask_; }
+
+        inline int slot(int logical) const {
+            int s = head_ + logical;
+            return s >= windows() ? s - windows() : s;
+        }
+
+        inline uint64_t readCell(const Line &line, int bit) const {
+            int word = bit >> 6;
+            int shift = bit & 63;
+            uint64_t v = line.words[word] >> shift;
+            if (shift + width() > 64) {
+                v |= line.words[word + 1] << (64 - shift);
+            }
+            return v & cellMask();
+        }
+
+        inline void setBit(Line &line, int bit) {
+            line.words[bit >> 6] |= 1ULL << (bit & 63);
+        }
+
+        // Clears the windows recycled since the line was last touched.
+        inline void refresh(Line &line) {
+            uint32_t epoch = static_cast<uint32_t>(line.words[LAST_WORD] >> 32);
+            uint32_t behind = rotations_ - epoch;
+            if (!behind) {
+                return;
+            }
+            if (behind >= static_cast<uint32_t>(windows())) {
+                std::fill(line.words, line.words + LAST_WORD, 0);
+                line.words[LAST_WORD] = 0;
+            } else {
+                for (uint32_t r = epoch; r != rotations_; ++r) {
+                    const Line &mask = slot_masks_[r % windows()];
+                    for (int w = 0; w <= LAST_WORD; ++w) {
+                        line.words[w] &= ~mask.words[w];
+                    }
+                }
+            }
+            line.words[LAST_WORD] = (line.words[LAST_WORD] & 0xFFFFFFFFULL) |
+                                    (static_cast<uint64_t>(rotations_) << 32);
+        }
+
+    public:
+        // total_bits is the memory budget in bits; it is rounded down to
+        // whole lines (at least one).
+        BlockedBitBf(int windows, int planes, uint64_t total_bits, int num_hash)
+                : windows_(windows), planes_(planes), width_(windows * planes),
+                  cells_(DATA_BITS / std::max(1, windows * planes)),
+                  num_hash_(std::min(std::max(1, num_hash), static_cast<int>(MAX_HASH))), head_(0), rotations_(0),
+                  num_lines_(static_cast<uint32_t>(std::max<uint64_t>(1, total_bits / LINE_BITS))),
+                  cell_mask_(width_ >= 64 ? ~0ULL : (1ULL << width_) - 1),
+                  plane_mask_((1ULL << planes) - 1),
+                  lines_(num_lines_), slot_masks_(windows) {
+            assert(width_ > 0 && width_ <= 64);
+            assert((!WINDOWS || WINDOWS == windows) && (!PLANES || PLANES == planes) && (!NUM_HASH || NUM_HASH == num_hash));
+            for (int s = 0; s < windows_; ++s) {
+                for (int c = 0; c < cells_; ++c) {
+                    for (int plane = 0; plane < planes_; ++plane) {
+                        setBit(slot_masks_[s], c * width_ + s * planes_ + plane);
+                    }
+                }
+            }
+        }
+
+        template <int32_t key_len>
+        inline Probe probe(const FlowKey<key_len> &flowkey) const {
+            uint64_t h = hash_fn_(flowkey);
+            Probe p;
+            p.line = core::FastRange32(static_cast<uint32_t>(h), num_lines_);
+            uint32_t x = static_cast<uint32_t>(h >> 32);
+            for (int i = 0; i < numHash(); ++i) {
+                p.bit[i] = static_cast<uint16_t>(core::FastRange32(x, cells()) * width());
+                x = x * 0x9E3779B1u + 0x7F4A7C15u;
+            }
+            return p;
+        }
+
+        // Membership bits of every (window, plane) for the probed key, in
+        // physical slot order; decode with value().
+        inline uint64_t query(const Probe &p) {
+            Line &line = lines_[p.line];
+            refresh(line);
+            uint64_t v = cellMask();
+            for (int i = 0; i < numHash(); ++i) {
+                v &= readCell(line, p.bit[i]);
+            }
+            return v;
+        }
+
+        // The planes-bit value stored for logical window `logical`.
+        inline uint64_t value(uint64_t bits, int logical) const {
+            return (bits >> (slot(logical) * planes())) & planeMask();
+        }
+
+        // Records value (1 .. 2^planes - 1) for the key in the newest window.
+        inline void update(const Probe &p, int value) {
+            assert(value <= static_cast<int>(planeMask()));
+            Line &line = lines_[p.line];
+            refresh(line);
+            int base = slot(windows() - 1) * planes();
+            for (int plane = 0; value; ++plane, value >>= 1) {
+                if (value & 1) {
+                    for (int i = 0; i < numHash(); ++i) {
+                        setBit(line, p.bit[i] + base + plane);
+                    }
+                }
+            }
+        }
+
+        // Drops the oldest window and makes it the (empty) newest one. The
+        // recycled slot is cleared in each line on its next access.
+        void rotate() {
+            head_ = slot(1);
+            ++rotations_;
+        }
+
+        void clear() {
+            lines_.zero();
+            head_ = 0;
+            rotations_ = 0;
+        }
+
+        size_t size() const { return lines_.bytes(); }
+    };
+
+} // namespace sketch
+
+#endif // SKETCH_BLOCKEDBITBF_HH
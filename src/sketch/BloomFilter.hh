@@ -3,33 +3,66 @@
 
 #include "utils/hash.hh"
 #include "utils/core.hh"
+#include "utils/aligned.hh"
 #include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <cstddef>
+#include <limits>
 #include <string>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace sketch {
+
+    // Bloom filter over cache-line-aligned 64-bit words.
+    //
+    // The bit count is rounded up to whole cache lines and positions are
+    // mapped with fastrange instead of a modulo by a prime. The num_hash
+    // positions come from one 64-bit hash by double hashing. And/Or/clear
+    // work a cache line at a time (AVX2 when built with it). The number of
+    // set bits is tracked on insert, so fillRatio() and estimatedFpr() are
+    // O(1) and callers can age the filter before it saturates.
     template <typename hash_t> class BloomFilter {
 
     private:
         int nbits_;
         int num_hash_;
-        int nbytes_;
-        uint8_t *arr_;
-        hash_t *hash_fns_;
-
-        static inline int BYTE(int n) { return n / 8; }
-        static inline int BIT(int n) { return n % 8; }
-        inline void setBit(int pos) { arr_[BYTE(pos)] |= 1 << (7 - BIT(pos)); }
-        inline void resetBit(int pos) { arr_[BYTE(pos)] &= ~(1 << (7 - BIT(pos))); }
-        inline uint8_t getBit(int pos) const {
-            return (arr_[BYTE(pos)] >> (7 - BIT(pos))) & 1;
+        int nwords_;
+        uint64_t ones_;
+        core::AlignedArray<uint64_t> words_;
+        hash_t hash_fn_;
+
+        inline uint32_t position(uint64_t h, int i) const {
+            uint32_t h1 = static_cast<uint32_t>(h);
+            uint32_t h2 = static_cast<uint32_t>(h >> 32) | 1;
+            return core::FastRange32(h1 + static_cast<uint32_t>(i) * h2, nbits_);
+        }
+        inline bool setBit(uint32_t pos) {
+            uint64_t &w = words_[pos >> 6];
+            uint64_t bit = 1ULL << (pos & 63);
+            bool was_set = w & bit;
+            w |= bit;
+            return !was_set;
+        }
+        inline bool resetBit(uint32_t pos) {
+            uint64_t &w = words_[pos >> 6];
+            uint64_t bit = 1ULL << (pos & 63);
+            bool was_set = w & bit;
+            w &= ~bit;
+            return was_set;
         }
+        inline bool getBit(uint32_t pos) const {
+            return (words_[pos >> 6] >> (pos & 63)) & 1;
+        }
+        void recount();
 
     public:
         BloomFilter(int nbits, int num_hash);
         BloomFilter();
-        ~BloomFilter();
-        BloomFilter(const BloomFilter<hash_t> &);
+        ~BloomFilter() = default;
+        BloomFilter(const BloomFilter<hash_t> &) = default;
         BloomFilter(BloomFilter<hash_t> &&) noexcept;
         BloomFilter<hash_t> &operator=(BloomFilter<hash_t>) noexcept;
         void swap(BloomFilter<hash_t> &bf) noexcept;
@@ -42,48 +75,36 @@ namespace sketch {
         static int getNbitsBySize(int num_hash, int mem_size);
         void And(const BloomFilter<hash_t> &rhs);
         void Or(const BloomFilter<hash_t> &rhs);
+
+        // Fraction of bits set.
+        double fillRatio() const { return nbits_ > 0 ? static_cast<double>(ones_) / nbits_ : 0.0; }
+        // False-positive probability at the current fill.
+        double estimatedFpr() const { return std::pow(fillRatio(), num_hash_); }
+        // Distinct keys inserted, estimated from the fill (Swamidass & Baldi).
+        double estimatedCount() const {
+            double fill = fillRatio();
+            return fill >= 1.0 ? std::numeric_limits<double>::infinity()
+                               : -static_cast<double>(nbits_) / num_hash_ * std::log1p(-fill);
+        }
     };
 
     template <typename hash_t>
     BloomFilter<hash_t>::BloomFilter()
-            : nbits_(0), num_hash_(0), nbytes_(0), arr_(nullptr), hash_fns_(nullptr) {}
+            : nbits_(0), num_hash_(0), nwords_(0), ones_(0) {}
 
     template <typename hash_t>
     BloomFilter<hash_t>::BloomFilter(int nbits, int num_hash)
-            : nbits_(nbits), num_hash_(num_hash) {
-        nbits_ = core::NextPrime(nbits_);
-        nbytes_ = (nbits_ & 7) == 0 ? (nbits_ >> 3) : (nbits_ >> 3) + 1;
-        hash_fns_ = new hash_t[num_hash_];
-        // Allocate memory
-        arr_ = new uint8_t[nbytes_]();
-        std::fill(arr_, arr_ + nbytes_, 0);
-    }
-    template <typename hash_t> BloomFilter<hash_t>::~BloomFilter() {
-        delete[] hash_fns_;
-        delete[] arr_;
+            : num_hash_(num_hash), ones_(0) {
+        const int line_bits = core::CACHE_LINE_SIZE * 8;
+        nbits_ = std::max(line_bits, (nbits + line_bits - 1) / line_bits * line_bits);
+        nwords_ = nbits_ / 64;
+        words_ = core::AlignedArray<uint64_t>(nwords_);
     }
 
     template <typename hash_t>
-    BloomFilter<hash_t>::BloomFilter(const BloomFilter &bf) {
-        nbits_ = bf.nbits_;
-        nbytes_ = bf.nbytes_;
-        num_hash_ = bf.num_hash_;
-        hash_fns_ = new hash_t[num_hash_];
-        std::copy(bf.hash_fns_, bf.hash_fns_ + num_hash_, hash_fns_);
-        arr_ = new uint8_t[nbytes_]();
-        std::copy(bf.arr_, bf.arr_ + nbytes_, arr_);
-    }
-
-    template <typename hash_t>
-    BloomFilter<hash_t>::BloomFilter(BloomFilter<hash_t> &&bf) noexcept {
-        hash_fns_ = bf.hash_fns_;
-        bf.hash_fns_ = nullptr;
-        arr_ = bf.arr_;
-        bf.arr_ = nullptr;
-        nbits_ = bf.nbits_;
-        nbytes_ = bf.nbytes_;
-        num_hash_ = bf.num_hash_;
-    }
+    BloomFilter<hash_t>::BloomFilter(BloomFilter<hash_t> &&bf) noexcept
+            : nbits_(bf.nbits_), num_hash_(bf.num_hash_), nwords_(bf.nwords_), ones_(bf.ones_),
+              words_(std::move(bf.words_)), hash_fn_(bf.hash_fn_) {}
 
     template <typename hash_t>
     BloomFilter<hash_t> &
@@ -96,52 +117,68 @@ namespace sketch {
     void BloomFilter<hash_t>::swap(BloomFilter<hash_t> &bf) noexcept {
         using std::swap;
         swap(nbits_, bf.nbits_);
-        swap(nbytes_, bf.nbytes_);
         swap(num_hash_, bf.num_hash_);
-        swap(hash_fns_, bf.hash_fns_);
-        swap(arr_, bf.arr_);
+        swap(nwords_, bf.nwords_);
+        swap(ones_, bf.ones_);
+        swap(hash_fn_, bf.hash_fn_);
+        words_.swap(bf.words_);
     }
 
     template <typename hash_t>
     template <int32_t key_len>
     void BloomFilter<hash_t>::insert(const FlowKey<key_len> &flowkey) {
+        uint64_t h = hash_fn_(flowkey);
         for (int i = 0; i < num_hash_; ++i) {
-            int idx = hash_fns_[i](flowkey) % nbits_;
-            setBit(idx);
+            ones_ += setBit(position(h, i));
         }
     }
 
     template <typename hash_t>
     template <int32_t key_len>
     void BloomFilter<hash_t>::reset(const FlowKey<key_len> &flowkey) {
+        uint64_t h = hash_fn_(flowkey);
         for (int i = 0; i < num_hash_; ++i) {
-            int idx = hash_fns_[i](flowkey) % nbits_;
-            resetBit(idx);
+            ones_ -= resetBit(position(h, i));
         }
     }
 
     template <typename hash_t>
     template <int32_t key_len>
     bool BloomFilter<hash_t>::query(const FlowKey<key_len> &flowkey) const {
+        uint64_t h = hash_fn_(flowkey);
         for (int i = 0; i < num_hash_; ++i) {
-            int idx = hash_fns_[i](flowkey) % nbits_;
-            if (getBit(idx) == 0) {
+            if (!getBit(position(h, i))) {
                 return false;
             }
         }
         return true;
     }
     template <typename hash_t> std::size_t BloomFilter<hash_t>::size() const {
-        return nbytes_ * sizeof(uint8_t);
+        return words_.bytes();
     }
     template <typename hash_t> void BloomFilter<hash_t>::clear() {
-        std::fill(arr_, arr_ + nbytes_, 0);
+#ifdef __AVX2__
+        const __m256i zero = _mm256_setzero_si256();
+        for (int i = 0; i < nwords_; i += 4) {
+            _mm256_store_si256(reinterpret_cast<__m256i *>(words_.data() + i), zero);
+        }
+#else
+        words_.zero();
+#endif
+        ones_ = 0;
     }
     template <typename hash_t>
     int BloomFilter<hash_t>::getNbitsBySize(int num_hash, int mem_size) {
-        int nbits =
-                (mem_size - sizeof(BloomFilter<hash_t>) - num_hash * sizeof(hash_t)) * 8;
-        return core::NearestPrime(nbits);
+        int nbits = (mem_size - sizeof(BloomFilter<hash_t>)) * 8;
+        return nbits / (core::CACHE_LINE_SIZE * 8) * (core::CACHE_LINE_SIZE * 8);
+    }
+
+    template <typename hash_t> void BloomFilter<hash_t>::recount() {
+        uint64_t ones = 0;
+        for (int i = 0; i < nwords_; ++i) {
+            ones += __builtin_popcountll(words_[i]);
+        }
+        ones_ = ones;
     }
 
     template <typename hash_t>
@@ -149,12 +186,21 @@ namespace sketch {
         assert(nbits_ == rhs.nbits_);
         assert(&rhs != this);
         assert(num_hash_ == rhs.num_hash_);
-        for (int i = 0; i < num_hash_; ++i) {
-            assert(hash_fns_[i] == rhs.hash_fns_[i]);
+        assert(hash_fn_ == rhs.hash_fn_);
+        uint64_t *dst = words_.data();
+        const uint64_t *src = rhs.words_.data();
+#ifdef __AVX2__
+        for (int i = 0; i < nwords_; i += 4) {
+            __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(dst + i));
+            __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i *>(src + i));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_and_si256(a, b));
         }
-        for (int i = 0; i < nbytes_; ++i) {
-            arr_[i] &= rhs.arr_[i];
+#else
+        for (int i = 0; i < nwords_; ++i) {
+            dst[i] &= src[i];
         }
+#endif
+        recount();
     }
 
     template <typename hash_t>
@@ -162,12 +208,21 @@ namespace sketch {
         assert(nbits_ == rhs.nbits_);
         assert(&rhs != this);
         assert(num_hash_ == rhs.num_hash_);
-        for (int i = 0; i < num_hash_; ++i) {
-            assert(hash_fns_[i] == rhs.hash_fns_[i]);
+        assert(hash_fn_ == rhs.hash_fn_);
+        uint64_t *dst = words_.data();
+        const uint64_t *src = rhs.words_.data();
+#ifdef __AVX2__
+        for (int i = 0; i < nwords_; i += 4) {
+            __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(dst + i));
+            __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i *>(src + i));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(a, b));
         }
-        for (int i = 0; i < nbytes_; ++i) {
-            arr_[i] |= rhs.arr_[i];
+#else
+        for (int i = 0; i < nwords_; ++i) {
+            dst[i] |= src[i];
         }
+#endif
+        recount();
     }
 } // namespace sketch
 template <typename hash_t>
@@ -175,4 +230,4 @@ void swap(sketch::BloomFilter<hash_t> &lbf,
           sketch::BloomFilter<hash_t> &rbf) noexcept {
     lbf.swap(rbf);
 }
-#endif
\ No newline at end of file
+#endif
@@ -3,22 +3,78 @@
 
 #include "utils/hash.hh"
 #include "utils/flowkey.hh"
+#include "utils/aligned.hh"
 #include <vector>
 #include <algorithm>
 #include <limits>
+#include <type_traits>
 
 namespace sketch {
 
-    template <typename hash_t>
+    // Count-Min sketch over one contiguous depth x width counter array.
+    //
+    // A single 64-bit hash per key derives every row index (double hashing),
+    // so updateAndQuery() touches each row exactly once. With conservative
+    // update enabled, a row counter is only raised as far as the new
+    // estimate, which keeps the one-sided error smaller at the same memory.
+    //
+    // counter_t may be uint8_t or uint16_t. A small counter that reaches its
+    // maximum escalates: further increments go to a 32-bit overflow counter
+    // shared by 2^OVERFLOW_SHIFT neighbouring counters of the same row. The
+    // sharing can only overestimate, so the Count-Min guarantee still holds.
+    template <typename hash_t, typename counter_t = uint32_t>
     class CMSketch {
+        static_assert(std::is_unsigned<counter_t>::value && sizeof(counter_t) <= sizeof(uint32_t),
+                      "CMSketch counters must be unsigned and at most 32 bits");
+
+    public:
+        static constexpr bool ESCALATE = sizeof(counter_t) < sizeof(uint32_t);
+        static constexpr int OVERFLOW_SHIFT = 4;
+
     private:
+        static constexpr uint32_t COUNTER_MAX = std::numeric_limits<counter_t>::max();
+
         int width_;
         int depth_;
-        std::vector<std::vector<uint32_t>> sketch_;
-        std::vector<hash_t> hash_fns_;
+        int overflow_width_;
+        bool conservative_;
+        std::vector<counter_t> sketch_;
+        std::vector<uint32_t> overflow_;
+        hash_t hash_fn_;
+
+        inline uint32_t index(uint64_t h, int row) const {
+            uint32_t h1 = static_cast<uint32_t>(h);
+            uint32_t h2 = static_cast<uint32_t>(h >> 32) | 1;
+            return core::FastRange32(h1 + static_cast<uint32_t>(row) * h2, width_);
+        }
+
+        inline uint32_t read(int row, uint32_t col) const {
+            uint32_t c = sketch_[static_cast<size_t>(row) * width_ + col];
+            if (ESCALATE && c == COUNTER_MAX) {
+                c += overflow_[static_cast<size_t>(row) * overflow_width_ + (col >> OVERFLOW_SHIFT)];
+            }
+            return c;
+        }
+
+        inline void add(int row, uint32_t col, uint32_t count) {
+            counter_t &c = sketch_[static_cast<size_t>(row) * width_ + col];
+            if (!ESCALATE) {
+                c += count;
+                return;
+            }
+            uint32_t &overflow = overflow_[static_cast<size_t>(row) * overflow_width_ + (col >> OVERFLOW_SHIFT)];
+            if (c == COUNTER_MAX) {
+                overflow += count;
+            } else if (static_cast<uint64_t>(c) + count >= COUNTER_MAX) {
+                overflow += static_cast<uint32_t>(c + count - COUNTER_MAX);
+                c = static_cast<counter_t>(COUNTER_MAX);
+            } else {
+                c += count;
+            }
+        }
 
     public:
-        CMSketch(int width, int depth);
+        CMSketch(int width, int depth, bool conservative = false);
         ~CMSketch() = default;
 
         template <int32_t key_len>
@@ -27,48 +83,87 @@ namespace sketch {
         template <int32_t key_len>
         uint32_t query(const FlowKey<key_len>& flowkey) const;
 
+        // Adds count to the key and returns its new estimate in one pass.
+        template <int32_t key_len>
+        uint32_t updateAndQuery(const FlowKey<key_len>& flowkey, int count = 1);
+
         void clear();
         size_t size() const;
+
+        // Bytes one counter costs, overflow share included; for sizing from a
+        // memory budget.
+        static double bytesPerCounter() {
+            return sizeof(counter_t) + (ESCALATE ? sizeof(uint32_t) / double(1 << OVERFLOW_SHIFT) : 0.0);
+        }
     };
 
-    template <typename hash_t>
-    CMSketch<hash_t>::CMSketch(int width, int depth)
-            : width_(width), depth_(depth), hash_fns_(depth) {
-        sketch_.resize(depth, std::vector<uint32_t>(width, 0));
+    template <typename hash_t, typename counter_t>
+    CMSketch<hash_t, counter_t>::CMSketch(int width, int depth, bool conservative)
+            : width_(std::max(1, width)), depth_(depth),
+              overflow_width_(ESCALATE ? (std::max(1, width) >> OVERFLOW_SHIFT) + 1 : 0),
+              conservative_(conservative),
+              sketch_(static_cast<size_t>(depth) * std::max(1, width), 0),
+              overflow_(static_cast<size_t>(depth) * overflow_width_, 0) {
     }
 
-    template <typename hash_t>
+    template <typename hash_t, typename counter_t>
     template <int32_t key_len>
-    void CMSketch<hash_t>::update(const FlowKey<key_len>& flowkey, int count) {
-        for (int i = 0; i < depth_; ++i) {
-            uint32_t index = hash_fns_[i](flowkey) % width_;
-            sketch_[i][index] += count;
-        }
+    void CMSketch<hash_t, counter_t>::update(const FlowKey<key_len>& flowkey, int count) {
+        updateAndQuery(flowkey, count);
     }
 
-    template <typename hash_t>
+    template <typename hash_t, typename counter_t>
     template <int32_t key_len>
-    uint32_t CMSketch<hash_t>::query(const FlowKey<key_len>& flowkey) const {
+    uint32_t CMSketch<hash_t, counter_t>::query(const FlowKey<key_len>& flowkey) const {
+        uint64_t h = hash_fn_(flowkey);
         uint32_t min_count = std::numeric_limits<uint32_t>::max();
         for (int i = 0; i < depth_; ++i) {
-            uint32_t index = hash_fns_[i](flowkey) % width_;
-            min_count = std::min(min_count, sketch_[i][index]);
+            min_count = std::min(min_count, read(i, index(h, i)));
         }
         return min_count;
     }
 
-    template <typename hash_t>
-    void CMSketch<hash_t>::clear() {
+    template <typename hash_t, typename counter_t>
+    template <int32_t key_len>
+    uint32_t CMSketch<hash_t, counter_t>::updateAndQuery(const FlowKey<key_len>& flowkey, int count) {
+        uint64_t h = hash_fn_(flowkey);
+        uint32_t min_count = std::numeric_limits<uint32_t>::max();
+
+        if (!conservative_) {
+            for (int i = 0; i < depth_; ++i) {
+                uint32_t col = index(h, i);
+                add(i, col, count);
+                min_count = std::min(min_count, read(i, col));
+            }
+            return min_count;
+        }
+
+        // Conservative update: raise each row only up to min + count.
+        for (int i = 0; i < depth_; ++i) {
+            min_count = std::min(min_count, read(i, index(h, i)));
+        }
+        uint32_t target = min_count + count;
         for (int i = 0; i < depth_; ++i) {
-            std::fill(sketch_[i].begin(), sketch_[i].end(), 0);
+            uint32_t col = index(h, i);
+            uint32_t val = read(i, col);
+            if (val < target) {
+                add(i, col, target - val);
+            }
         }
+        return target;
+    }
+
+    template <typename hash_t, typename counter_t>
+    void CMSketch<hash_t, counter_t>::clear() {
+        std::fill(sketch_.begin(), sketch_.end(), 0);
+        std::fill(overflow_.begin(), overflow_.end(), 0);
     }
 
-    template <typename hash_t>
-    size_t CMSketch<hash_t>::size() const {
-        return depth_ * width_ * sizeof(uint32_t);
+    template <typename hash_t, typename counter_t>
+    size_t CMSketch<hash_t, counter_t>::size() const {
+        return sketch_.size() * sizeof(counter_t) + overflow_.size() * sizeof(uint32_t);
     }
 
 } // namespace sketch
 
-#endif // SKETCH_CMSKETCH_HH
\ No newline at end of file
+#endif // SKETCH_CMSKETCH_HH
@@ -5,27 +5,61 @@
 #include "utils/flowkey.hh"
 #include "utils/hash.hh"
 #include "sketch/CMSketch.hh"
+#include "sketch/IfpdTable.hh"
 #include "utils/BOBHash.hh"
+#include "utils/aligned.hh"
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <limits>
 #include <tuple>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace sketch {
 
-    struct DelaySketchBucket {
-        uint16_t fp;
-        uint64_t t;
+    // One cache line holding the candidate slots of every key hashed to it.
+    // Slots are packed as a 16-bit fingerprint array followed by a 32-bit
+    // timestamp array relative to the sketch start time (~71 minutes of
+    // range at microsecond resolution; deltas are taken modulo 2^32).
+    // fp == 0 marks an empty slot.
+    struct alignas(core::CACHE_LINE_SIZE) DelaySketchLine {
+        static constexpr int SLOTS = 10;
+        uint16_t fp[SLOTS];
+        uint32_t t[SLOTS];
+
+        // Bit 2*i (and 2*i+1) is set when fp[i] == key, for i < SLOTS.
+        inline uint32_t match(uint16_t key) const {
+#ifdef __SSE2__
+            const __m128i k = _mm_set1_epi16(static_cast<short>(key));
+            const __m128i *p = reinterpret_cast<const __m128i *>(fp);
+            uint32_t lo = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_load_si128(p), k));
+            uint32_t hi = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_load_si128(p + 1), k));
+            return (lo | (hi << 16)) & ((1u << (2 * SLOTS)) - 1);
+#else
+            uint32_t mask = 0;
+            for (int i = 0; i < SLOTS; ++i) {
+                if (fp[i] == key) {
+                    mask |= 3u << (2 * i);
+                }
+            }
+            return mask;
+#endif
+        }
     };
+    static_assert(sizeof(DelaySketchLine) == core::CACHE_LINE_SIZE, "DelaySketchLine must fill one cache line");
 
     template <typename hash_t>
     class DelaySketch : public AbstractDetector {
     private:
         int d_;
-        int w_;
-        std::vector<std::vector<DelaySketchBucket>> sketch_;
-        std::vector<hash_t> hash_fns_;
+        uint32_t num_lines_;
+        core::AlignedArray<DelaySketchLine> lines_;
+        // A key's d candidates are d consecutive slots (wrapping) from a hashed
+        // offset, kept in the 2-bits-per-slot form returned by match().
+        uint32_t cand_masks_[DelaySketchLine::SLOTS];
+        hash_t hash_fn_;
         hash::BOBHash32 fp_hash_;
 
         CMSketch<hash_t> cm_sketch_;
@@ -33,16 +67,17 @@ namespace sketch {
         uint64_t min_absolute_jitter_thres_;
         uint64_t max_ifpd_diff_;
         int jitter_detection_mode_;
-        std::vector<std::pair<FlowKey<13>, uint64_t>> last_ifpd_map_;
-        size_t last_ifpd_map_size_;
-        hash::BOBHash32 ifpd_hash_;
+        IfpdTable<hash_t> last_ifpd_map_;
         int frequency_threshold_;
         std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>> abnormal_events_;
         uint64_t start_time_;
 
     public:
-        DelaySketch(int d, int w, double jitter_factor, uint64_t min_absolute_jitter_thres,
-                    uint64_t max_ifpd_diff, size_t ifpd_map_size, int cm_width, int cm_depth, int jitter_detection_mode, int frequency_threshold);
+        // d candidate slots per key (at most DelaySketchLine::SLOTS), all in one
+        // of num_lines cache lines.
+        DelaySketch(int d, int num_lines, double jitter_factor, uint64_t min_absolute_jitter_thres,
+                    uint64_t max_ifpd_diff, size_t ifpd_map_size, int cm_width, int cm_depth, int jitter_detection_mode, int frequency_threshold,
+                    bool cm_conservative = false);
         ~DelaySketch() = default;
 
         void setInitTime(uint64_t timestamp) override {
@@ -51,80 +86,95 @@ namespace sketch {
         std::string name() override { return "DelaySketch"; }
         size_t size() const override;
         uint64_t update(const FlowKey<13>& flowkey, uint64_t timestamp) override;
+        void updateBatch(const core::Record *records, size_t n) override;
         auto clear() -> void override;
 
         const std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>>& getAbnormalEvents() const {
             return abnormal_events_;
         }
+#ifdef JITTERSKETCH_STATS
+        const IfpdTable<hash_t>& ifpdTable() const { return last_ifpd_map_; }
+#endif
     };
 
     template <typename hash_t>
-    DelaySketch<hash_t>::DelaySketch(int d, int w, double jitter_factor, uint64_t min_absolute_jitter_thres,
-                                     uint64_t max_ifpd_diff, size_t ifpd_map_size, int cm_width, int cm_depth, int jitter_detection_mode, int frequency_threshold)
-            : d_(d), w_(w), hash_fns_(d),
+    DelaySketch<hash_t>::DelaySketch(int d, int num_lines, double jitter_factor, uint64_t min_absolute_jitter_thres,
+                                     uint64_t max_ifpd_diff, size_t ifpd_map_size, int cm_width, int cm_depth, int jitter_detection_mode, int frequency_threshold,
+                                     bool cm_conservative)
+            : d_(std::max(1, std::min(d, static_cast<int>(DelaySketchLine::SLOTS)))),
+              num_lines_(static_cast<uint32_t>(std::max(1, num_lines))), lines_(num_lines_),
               jitter_factor_(jitter_factor), min_absolute_jitter_thres_(min_absolute_jitter_thres),
-              max_ifpd_diff_(max_ifpd_diff), last_ifpd_map_size_(ifpd_map_size),
-              cm_sketch_(cm_width, cm_depth), jitter_detection_mode_(jitter_detection_mode), frequency_threshold_(frequency_threshold) {
-        sketch_.resize(d, std::vector<DelaySketchBucket>(w, {0, 0}));
-        last_ifpd_map_.resize(last_ifpd_map_size_);
+              max_ifpd_diff_(max_ifpd_diff), last_ifpd_map_(ifpd_map_size),
+              cm_sketch_(cm_width, cm_depth, cm_conservative), jitter_detection_mode_(jitter_detection_mode), frequency_threshold_(frequency_threshold),
+              start_time_(0) {
+        for (int offset = 0; offset < DelaySketchLine::SLOTS; ++offset) {
+            cand_masks_[offset] = 0;
+            for (int i = 0; i < d_; ++i) {
+                cand_masks_[offset] |= 3u << (2 * ((offset + i) % DelaySketchLine::SLOTS));
+            }
+        }
     }
 
     template <typename hash_t>
     size_t DelaySketch<hash_t>::size() const {
-        return (d_ * w_ * sizeof(DelaySketchBucket)) +
-               (last_ifpd_map_size_ * sizeof(std::pair<FlowKey<13>, uint64_t>)) +
+        return lines_.bytes() +
+               last_ifpd_map_.size() +
                cm_sketch_.size();
     }
 
+    template <typename hash_t>
+    void DelaySketch<hash_t>::updateBatch(const core::Record *records, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            DelaySketch::update(records[i].flowkey_, records[i].timestamp_);
+        }
+    }
+
     template <typename hash_t>
     uint64_t DelaySketch<hash_t>::update(const FlowKey<13>& flowkey, uint64_t timestamp) {
         uint16_t fp_x = fp_hash_(flowkey) & 0xFFFF;
-        uint64_t esti_delay = 0;
-        bool updated = false;
-
-        for (int i = 0; i < d_ && !updated; ++i) {
-            uint32_t j = hash_fns_[i](flowkey) % w_;
-            DelaySketchBucket& bucket = sketch_[i][j];
-
-            if (bucket.fp == fp_x) {
-                esti_delay = (timestamp > bucket.t) ? (timestamp - bucket.t) : 0;
-                bucket.t = timestamp;
-                updated = true;
-            } else if (bucket.fp == 0 && bucket.t == 0) {
-                esti_delay = 0;
-                bucket.fp = fp_x;
-                bucket.t = timestamp;
-                updated = true;
-            }
+        if (fp_x == 0) {
+            fp_x = 1;
         }
+        uint64_t h = hash_fn_(flowkey);
+        DelaySketchLine& line = lines_[core::FastRange32(static_cast<uint32_t>(h), num_lines_)];
+        uint32_t now = static_cast<uint32_t>(timestamp - start_time_);
+
+        int offset = static_cast<int>((h >> 32) % DelaySketchLine::SLOTS);
+        uint32_t cand = cand_masks_[offset];
 
-        if (!updated) {
-            int replace_row = -1;
-            uint32_t replace_col = 0;
-            uint64_t max_t = 0;
+        uint64_t esti_delay = 0;
+        uint32_t hit = line.match(fp_x) & cand;
+        if (!hit) {
+            hit = line.match(0) & cand;
+        }
 
+        if (hit) {
+            int slot = __builtin_ctz(hit) >> 1;
+            esti_delay = (line.fp[slot] == fp_x) ? static_cast<uint32_t>(now - line.t[slot]) : 0;
+            line.fp[slot] = fp_x;
+            line.t[slot] = now;
+        } else {
+            // No match and no empty candidate: take over the most recently
+            // touched candidate, as the row-based layout did.
+            int replace_slot = -1;
+            uint32_t min_age = std::numeric_limits<uint32_t>::max();
             for (int i = 0; i < d_; ++i) {
-                uint32_t j = hash_fns_[i](flowkey) % w_;
-                if (sketch_[i][j].t > max_t) {
-                    max_t = sketch_[i][j].t;
-                    replace_row = i;
-                    replace_col = j;
+                int slot = (offset + i) % DelaySketchLine::SLOTS;
+                uint32_t age = now - line.t[slot];
+                if (replace_slot == -1 || age < min_age) {
+                    min_age = age;
+                    replace_slot = slot;
                 }
             }
-            if (replace_row != -1) {
-                DelaySketchBucket& bucket_to_replace = sketch_[replace_row][replace_col];
-                esti_delay = (timestamp > bucket_to_replace.t) ? (timestamp - bucket_to_replace.t) : 0;
-                bucket_to_replace.fp = fp_x;
-                bucket_to_replace.t = timestamp;
-            }
+            esti_delay = min_age;
+            line.fp[replace_slot] = fp_x;
+            line.t[replace_slot] = now;
         }
 
-        cm_sketch_.update(flowkey);
-        if (cm_sketch_.query(flowkey) >= frequency_threshold_) {
-            uint32_t index = ifpd_hash_(flowkey) % last_ifpd_map_size_;
-            auto& entry = last_ifpd_map_[index];
-            if (entry.first == flowkey) {
-                uint64_t old_ifpd = entry.second;
+        if (cm_sketch_.updateAndQuery(flowkey) >= frequency_threshold_) {
+            auto entry = last_ifpd_map_.lookup(flowkey);
+            if (entry.found()) {
+                uint64_t old_ifpd = *entry.ifpd;
                 uint64_t diff = std::abs((int64_t)esti_delay - (int64_t)old_ifpd);
 
                 bool deceleration_jitter = (old_ifpd > 0 && esti_delay > jitter_factor_ * old_ifpd);
@@ -143,7 +193,7 @@ namespace sketch {
                     abnormal_events_.emplace_back(flowkey, old_ifpd, esti_delay, timestamp);
                 }
             }
-            entry = {flowkey, esti_delay};
+            last_ifpd_map_.store(entry, esti_delay);
         }
 
         return esti_delay;
@@ -151,10 +201,8 @@ namespace sketch {
 
     template <typename hash_t>
     auto DelaySketch<hash_t>::clear() -> void {
-        for (auto& row : sketch_) {
-            std::fill(row.begin(), row.end(), DelaySketchBucket{0, 0});
-        }
-        std::fill(last_ifpd_map_.begin(), last_ifpd_map_.end(), std::pair<FlowKey<13>, uint64_t>());
+        lines_.zero();
+        last_ifpd_map_.clear();
         abnormal_events_.clear();
         cm_sketch_.clear();
     }
@@ -3,10 +3,12 @@
 
 #include "utils/flowkey.hh"
 #include "utils/hash.hh"
-#include "sketch/BitBloomFilter.hh"
+#include "sketch/BloomFilter.hh"
+#include "sketch/BlockedBitBf.hh"
 #include "detector/AbstractDetector.hh"
 #include "utils/BOBHash.hh"
 #include "sketch/CMSketch.hh"
+#include "sketch/IfpdTable.hh"
 #include <algorithm>
 #include <limits>
 #include <string>
@@ -16,11 +18,21 @@
 
 namespace sketch {
 
-    template <typename hash_t>
+    // K, KK and NUM_HASH pin k, kk and num_hash at compile time so the window
+    // loops unroll and the sub-window arithmetic folds to constants; 0 (the
+    // default) reads them from the constructor. Use dispatchFDFilter() in
+    // FDFilterFactory.hh to pick a specialization from runtime settings.
+    template <typename hash_t, int K = 0, int KK = 0, int NUM_HASH = 0>
     class FDFilter : public AbstractDetector {
     private:
-        std::vector<BitBf<hash_t>> bfs_;
+        BlockedBitBf<hash_t, K ? K + 1 : 0, KK, NUM_HASH> bfs_;  // k + 1 windows of kk-bit sub-window ids
         BloomFilter<hash_t> gbf_;
+        // With gbf_max_fill > 0 the seen-flow filter ages: gnbits is split into
+        // two generations, and once the current one passes gbf_max_fill it
+        // becomes the previous one and a cleared filter takes its place.
+        BloomFilter<hash_t> gbf_prev_;
+        double gbf_max_fill_;
+        uint64_t gbf_rotations_ = 0;
         CMSketch<hash_t> cm_sketch_;
         int k_;
         int kk_;
@@ -28,23 +40,30 @@ namespace sketch {
         int sub_win_num = 0;
         uint64_t start_time_;
         uint64_t delay_thres_;
+        uint64_t interval_;
         uint64_t last_update_;
 
         double jitter_factor_;
         uint64_t min_absolute_jitter_thres_;
         uint64_t max_ifpd_diff_;
         int jitter_detection_mode_;
-        std::vector<std::pair<FlowKey<13>, uint64_t>> last_ifpd_map_;
-        size_t last_ifpd_map_size_;
-        hash::BOBHash32 ifpd_hash_;
+        IfpdTable<hash_t> last_ifpd_map_;
         const int C = 30;
         std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>> abnormal_events_;
 
+        inline int k() const { return K ? K : k_; }
+        inline int kk() const { return KK ? KK : kk_; }
+        inline int subWindows() const { return (1 << kk()) - 1; }
+        inline int parts() const { return (K && KK) ? K * ((1 << KK) - 1) : part; }
+
     public:
+        static constexpr bool SPECIALIZED = K && KK && NUM_HASH;
+
         FDFilter(int k, int kk, int nbits, int num_hash,
                  int gnbits, int gnum_hash, uint64_t delay_thres, double jitter_factor,
                  uint64_t min_absolute_jitter_thres, uint64_t max_ifpd_diff,
-                 size_t ifpd_map_size, int cm_width, int cm_depth, int jitter_detection_mode, int m);
+                 size_t ifpd_map_size, int cm_width, int cm_depth, int jitter_detection_mode, int m,
+                 bool cm_conservative = false, double gbf_max_fill = 0.0);
         ~FDFilter();
 
         void setInitTime(uint64_t timestamp) override {
@@ -53,64 +72,90 @@ namespace sketch {
         std::string name() override { return "FDFilter"; }
         size_t size() const override;
         uint64_t update(const FlowKey<13> &flowkey, uint64_t timestamp) override;
+        void updateBatch(const core::Record *records, size_t n) override;
         auto clear() -> void override;
 
         const std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>>& getAbnormalEvents() const {
             return abnormal_events_;
         }
+
+        double gbfFillRatio() const { return gbf_.fillRatio(); }
+        uint64_t gbfRotations() const { return gbf_rotations_; }
+#ifdef JITTERSKETCH_STATS
+        const IfpdTable<hash_t>& ifpdTable() const { return last_ifpd_map_; }
+#endif
     };
 
-    template <typename hash_t>
-    FDFilter<hash_t>::FDFilter(int k, int kk, int nbits, int num_hash,
+    template <typename hash_t, int K, int KK, int NUM_HASH>
+    FDFilter<hash_t, K, KK, NUM_HASH>::FDFilter(int k, int kk, int nbits, int num_hash,
                                int gnbits, int gnum_hash, uint64_t delay_thres, double jitter_factor,
                                uint64_t min_absolute_jitter_thres, uint64_t max_ifpd_diff,
-                               size_t ifpd_map_size, int cm_width, int cm_depth, int jitter_detection_mode, int m)
+                               size_t ifpd_map_size, int cm_width, int cm_depth, int jitter_detection_mode, int m,
+                               bool cm_conservative, double gbf_max_fill)
             : k_(k), kk_(kk), delay_thres_(delay_thres), jitter_factor_(jitter_factor),
               min_absolute_jitter_thres_(min_absolute_jitter_thres), max_ifpd_diff_(max_ifpd_diff),
-              gbf_(gnbits, gnum_hash),
-              bfs_(k + 1, BitBf<hash_t>(kk, nbits, num_hash, delay_thres / (k * ((1 << kk) - 1)))),
-              last_ifpd_map_size_(ifpd_map_size),
-              cm_sketch_(cm_width, cm_depth),
+              gbf_(gbf_max_fill > 0 ? gnbits / 2 : gnbits, gnum_hash),
+              gbf_prev_(gbf_max_fill > 0 ? gnbits / 2 : 0, gbf_max_fill > 0 ? gnum_hash : 0),
+              gbf_max_fill_(gbf_max_fill),
+              bfs_(k + 1, kk, static_cast<uint64_t>(k + 1) * kk * nbits, num_hash),
+              last_ifpd_map_(ifpd_map_size),
+              cm_sketch_(cm_width, cm_depth, cm_conservative),
               jitter_detection_mode_(jitter_detection_mode)
     {
         part = k * ((1 << kk) - 1);
-        last_ifpd_map_.resize(last_ifpd_map_size_);
+        interval_ = part > 0 ? delay_thres_ / part : 0;
     }
 
-    template <typename hash_t>
-    FDFilter<hash_t>::~FDFilter() {}
+    template <typename hash_t, int K, int KK, int NUM_HASH>
+    FDFilter<hash_t, K, KK, NUM_HASH>::~FDFilter() {}
+
+    template <typename hash_t, int K, int KK, int NUM_HASH>
+    void FDFilter<hash_t, K, KK, NUM_HASH>::updateBatch(const core::Record *records, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            FDFilter::update(records[i].flowkey_, records[i].timestamp_);
+        }
+    }
 
-    template <typename hash_t>
-    uint64_t FDFilter<hash_t>::update(const FlowKey<13> &flowkey, uint64_t timestamp) {
-        if ((timestamp - last_update_) * part >= delay_thres_) {
+    template <typename hash_t, int K, int KK, int NUM_HASH>
+    uint64_t FDFilter<hash_t, K, KK, NUM_HASH>::update(const FlowKey<13> &flowkey, uint64_t timestamp) {
+        if ((timestamp - last_update_) * parts() >= delay_thres_) {
             last_update_ = timestamp;
             sub_win_num++;
-            if (sub_win_num % ((1 << kk_) - 1) == 0) {
-                for (int i = 0; i < k_; ++i) {
-                    bfs_[i].swap(bfs_[i + 1]);
-                }
-                bfs_[k_].clear();
+            if (sub_win_num % subWindows() == 0) {
+                bfs_.rotate();
             }
         }
 
         uint64_t esti_delay = 0;
-        if (!gbf_.query(flowkey)) {
+        auto probe = bfs_.probe(flowkey);
+        bool seen = gbf_.query(flowkey);
+        if (!seen && gbf_max_fill_ > 0 && gbf_prev_.query(flowkey)) {
             gbf_.insert(flowkey);
-            bfs_[k_].update(flowkey, sub_win_num % ((1 << kk_) - 1) + 1);
+            seen = true;
+        }
+        if (gbf_max_fill_ > 0 && gbf_.fillRatio() > gbf_max_fill_) {
+            gbf_prev_.swap(gbf_);
+            gbf_.clear();
+            gbf_rotations_++;
+        }
+        if (!seen) {
+            gbf_.insert(flowkey);
+            bfs_.update(probe, sub_win_num % subWindows() + 1);
             esti_delay = 0;
         } else {
+            uint64_t bits = bfs_.query(probe);
             int i = 0;
             uint64_t ret = 0;
-            for (; i <= k_; ++i) {
-                if ((ret = bfs_[k_ - i].query(flowkey))) {
+            for (; i <= k(); ++i) {
+                if ((ret = bfs_.value(bits, k() - i))) {
                     break;
                 }
             }
 
-            uint64_t interval = delay_thres_ / part;
-            int now = sub_win_num % ((1 << kk_) - 1) + 1;
+            uint64_t interval = interval_;
+            int now = sub_win_num % subWindows() + 1;
 
-            bfs_[k_].update(flowkey, now);
+            bfs_.update(probe, now);
 
             if (i == 0) {
                 if (ret == now)
@@ -119,17 +164,15 @@ namespace sketch {
                     esti_delay = timestamp - last_update_ + (now - 1) * interval;
             } else {
                 esti_delay = timestamp - last_update_ +
-                             (((1 << kk_) - 1) - (int)ret + (i - 1) * ((1 << kk_) - 1) + now - 1) * interval +
+                             (subWindows() - (int)ret + (i - 1) * subWindows() + now - 1) * interval +
                              interval / 2;
             }
         }
 
-        cm_sketch_.update(flowkey);
-        if (cm_sketch_.query(flowkey) >= C) {
-            uint32_t index = ifpd_hash_(flowkey) % last_ifpd_map_size_;
-            auto& entry = last_ifpd_map_[index];
-            if (entry.first == flowkey) {
-                uint64_t old_ifpd = entry.second;
+        if (cm_sketch_.updateAndQuery(flowkey) >= C) {
+            auto entry = last_ifpd_map_.lookup(flowkey);
+            if (entry.found()) {
+                uint64_t old_ifpd = *entry.ifpd;
                 uint64_t diff = std::abs((int64_t)esti_delay - (int64_t)old_ifpd);
 
                 bool deceleration_jitter = (old_ifpd > 0 && esti_delay > jitter_factor_ * old_ifpd);
@@ -148,25 +191,23 @@ namespace sketch {
                     abnormal_events_.emplace_back(flowkey, old_ifpd, esti_delay, timestamp);
                 }
             }
-            entry = {flowkey, esti_delay};
+            last_ifpd_map_.store(entry, esti_delay);
         }
 
         return esti_delay;
     }
 
-    template <typename hash_t>
-    size_t FDFilter<hash_t>::size() const {
-        return bfs_[0].size() * (k_ + 1) + gbf_.size() +
-               last_ifpd_map_size_ * sizeof(std::pair<FlowKey<13>, uint64_t>) +
+    template <typename hash_t, int K, int KK, int NUM_HASH>
+    size_t FDFilter<hash_t, K, KK, NUM_HASH>::size() const {
+        return bfs_.size() + gbf_.size() + (gbf_max_fill_ > 0 ? gbf_prev_.size() : 0) +
+               last_ifpd_map_.size() +
                cm_sketch_.size();
     }
 
-    template <typename hash_t>
-    auto FDFilter<hash_t>::clear() -> void {
-        for (auto &bf : bfs_) {
-            bf.clear();
-        }
-        std::fill(last_ifpd_map_.begin(), last_ifpd_map_.end(), std::pair<FlowKey<13>, uint64_t>());
+    template <typename hash_t, int K, int KK, int NUM_HASH>
+    auto FDFilter<hash_t, K, KK, NUM_HASH>::clear() -> void {
+        bfs_.clear();
+        last_ifpd_map_.clear();
         abnormal_events_.clear();
         cm_sketch_.clear();
     }
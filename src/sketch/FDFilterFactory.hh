@@ -0,0 +1,32 @@
+#ifndef SKETCH_FDFILTERFACTORY_HH
+#define SKETCH_FDFILTERFACTORY_HH
+
+#include "sketch/FDFilter.hh"
+#include <utility>
+
+namespace sketch {
+
+    // Builds the FDFilter specialization matching (k, kk, num_hash) and hands
+    // it to fn; configurations without a specialization get the generic
+    // runtime-parameter FDFilter. The arguments are FDFilter's constructor
+    // arguments. Add a line to the list below to specialize a deployment.
+    template <typename hash_t, typename fn_t, typename... args_t>
+    void dispatchFDFilter(fn_t &&fn, int k, int kk, int nbits, int num_hash, args_t &&... args) {
+#define FDFILTER_SPECIALIZE(K, KK, NUM_HASH)                                                    \
+        if (k == K && kk == KK && num_hash == NUM_HASH) {                                       \
+            FDFilter<hash_t, K, KK, NUM_HASH> filter(k, kk, nbits, num_hash, std::forward<args_t>(args)...); \
+            fn(filter);                                                                         \
+            return;                                                                             \
+        }
+        FDFILTER_SPECIALIZE(8, 2, 6)   // shipped settings.conf
+        FDFILTER_SPECIALIZE(8, 2, 4)
+        FDFILTER_SPECIALIZE(4, 2, 4)
+        FDFILTER_SPECIALIZE(4, 3, 6)
+#undef FDFILTER_SPECIALIZE
+        FDFilter<hash_t> filter(k, kk, nbits, num_hash, std::forward<args_t>(args)...);
+        fn(filter);
+    }
+
+} // namespace sketch
+
+#endif // SKETCH_FDFILTERFACTORY_HH
@@ -0,0 +1,166 @@
+#ifndef SKETCH_IFPDTABLE_HH
+#define SKETCH_IFPDTABLE_HH
+
+#include "utils/flowkey.hh"
+#include "utils/aligned.hh"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sketch {
+
+    // One cache line of the IFPD table: eight 32-bit flow fingerprints
+    // followed by their IFPDs, saturated to 32 bits. fp == 0 is empty.
+    struct alignas(core::CACHE_LINE_SIZE) IfpdBucket {
+        static constexpr int SLOTS = 8;
+        uint32_t fp[SLOTS];
+        uint32_t ifpd[SLOTS];
+
+        // Bit 4*i is set when fp[i] == key.
+        inline uint32_t match(uint32_t key) const {
+#ifdef __SSE2__
+            const __m128i k = _mm_set1_epi32(static_cast<int>(key));
+            const __m128i *p = reinterpret_cast<const __m128i *>(fp);
+            uint32_t lo = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(p), k));
+            uint32_t hi = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(p + 1), k));
+            return (lo | (hi << 16)) & 0x11111111u;
+#else
+            uint32_t mask = 0;
+            for (int i = 0; i < SLOTS; ++i) {
+                if (fp[i] == key) {
+                    mask |= 1u << (4 * i);
+                }
+            }
+            return mask;
+#endif
+        }
+    };
+    static_assert(sizeof(IfpdBucket) == core::CACHE_LINE_SIZE, "IfpdBucket must fill one cache line");
+
+    // Last-IFPD store for frequent flows: a bucketized cuckoo table of
+    // fingerprint/IFPD pairs. Each flow has two candidate buckets; the
+    // alternate bucket is derived from the fingerprint alone
+    // (alt = (h(fp) - b) mod n, an involution), so entries can be relocated
+    // without their keys. Inserts displace at most MAX_KICKS entries; when
+    // that runs out the last displaced entry is dropped. With
+    // JITTERSKETCH_STATS it also counts lookups and hits.
+    template <typename hash_t>
+    class IfpdTable {
+    public:
+        static constexpr int MAX_KICKS = 4;
+        static constexpr size_t ENTRY_BYTES = sizeof(uint32_t) * 2;
+
+        // Result of lookup(): where the flow lives, or where to insert it.
+        struct Ref {
+            uint32_t fp;
+            uint32_t b1, b2;
+            uint32_t *ifpd;
+            bool found() const { return ifpd != nullptr; }
+        };
+
+    private:
+        uint32_t num_buckets_;
+        core::AlignedArray<IfpdBucket> buckets_;
+        hash_t hash_fn_;
+#ifdef JITTERSKETCH_STATS
+        uint64_t lookups_ = 0;
+        uint64_t hits_ = 0;
+#endif
+
+        inline uint32_t altBucket(uint32_t b, uint32_t fp) const {
+            uint32_t h = core::FastRange32(fp * 0x5bd1e995u, num_buckets_);
+            return h >= b ? h - b : h + num_buckets_ - b;
+        }
+
+        inline bool place(uint32_t b, uint32_t fp, uint32_t ifpd) {
+            uint32_t empty = buckets_[b].match(0);
+            if (!empty) {
+                return false;
+            }
+            int slot = __builtin_ctz(empty) >> 2;
+            buckets_[b].fp[slot] = fp;
+            buckets_[b].ifpd[slot] = ifpd;
+            return true;
+        }
+
+        static inline uint32_t compact(uint64_t ifpd) {
+            return static_cast<uint32_t>(std::min<uint64_t>(ifpd, std::numeric_limits<uint32_t>::max()));
+        }
+
+    public:
+        // Holds at least num_entries entries.
+        explicit IfpdTable(size_t num_entries)
+                : num_buckets_(static_cast<uint32_t>(std::max<size_t>(1, (num_entries + IfpdBucket::SLOTS - 1) / IfpdBucket::SLOTS))),
+                  buckets_(num_buckets_) {}
+
+        template <int32_t key_len>
+        Ref lookup(const FlowKey<key_len> &flowkey) {
+            uint64_t h = hash_fn_(flowkey);
+            Ref ref;
+            ref.fp = static_cast<uint32_t>(h >> 32);
+            if (ref.fp == 0) {
+                ref.fp = 1;
+            }
+            ref.b1 = core::FastRange32(static_cast<uint32_t>(h), num_buckets_);
+            ref.b2 = altBucket(ref.b1, ref.fp);
+            ref.ifpd = nullptr;
+
+            uint32_t m = buckets_[ref.b1].match(ref.fp);
+            if (m) {
+                ref.ifpd = &buckets_[ref.b1].ifpd[__builtin_ctz(m) >> 2];
+            } else if ((m = buckets_[ref.b2].match(ref.fp))) {
+                ref.ifpd = &buckets_[ref.b2].ifpd[__builtin_ctz(m) >> 2];
+            }
+#ifdef JITTERSKETCH_STATS
+            ++lookups_;
+            if (ref.ifpd) {
+                ++hits_;
+            }
+#endif
+            return ref;
+        }
+
+        // Writes ifpd for the flow lookup() resolved, inserting it if absent.
+        void store(const Ref &ref, uint64_t ifpd) {
+            if (ref.ifpd) {
+                *ref.ifpd = compact(ifpd);
+                return;
+            }
+            uint32_t fp = ref.fp;
+            uint32_t val = compact(ifpd);
+            if (place(ref.b1, fp, val) || place(ref.b2, fp, val)) {
+                return;
+            }
+            uint32_t b = (fp & 1) ? ref.b1 : ref.b2;
+            for (int kick = 0; kick < MAX_KICKS; ++kick) {
+                int slot = (fp + kick) % IfpdBucket::SLOTS;
+                std::swap(fp, buckets_[b].fp[slot]);
+                std::swap(val, buckets_[b].ifpd[slot]);
+                b = altBucket(b, fp);
+                if (place(b, fp, val)) {
+                    return;
+                }
+            }
+        }
+
+        void clear() {
+            buckets_.zero();
+#ifdef JITTERSKETCH_STATS
+            lookups_ = hits_ = 0;
+#endif
+        }
+
+        size_t size() const { return buckets_.bytes(); }
+
+#ifdef JITTERSKETCH_STATS
+        uint64_t lookups() const { return lookups_; }
+        uint64_t hits() const { return hits_; }
+#endif
+    };
+
+} // namespace sketch
+
+#endif // SKETCH_IFPDTABLE_HH
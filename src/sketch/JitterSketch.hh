@@ -6,6 +6,7 @@
 #include "utils/flowkey.hh"
 #include "utils/hash.hh"
 #include "utils/BOBHash.hh"
+#include "sketch/JitterSketchStats.hh"
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -36,10 +37,6 @@ namespace sketch
         JitterSketchStageThreeEntry() : lastArrivalTime(0), IFPD(0) {}
     };
 
-    struct JitterSketchStageThreeBucket{
-        std::vector<JitterSketchStageThreeEntry> entries;
-        JitterSketchStageThreeBucket(size_t entry_num = 4) : entries(entry_num) {}
-    };
 
 
     template <typename hash_t>
@@ -50,7 +47,9 @@ namespace sketch
 
         std::vector<JitterSketchStageOneBucket> stage_one_;
         std::vector<JitterSketchStageTwoBucket> stage_two_;
-        std::vector<JitterSketchStageThreeBucket> stage_three_;
+        // w3_ buckets of d3_ entries, stored back to back, so a bucket's
+        // address is known from its index without loading anything.
+        std::vector<JitterSketchStageThreeEntry> stage_three_;
 
         int w1_, w2_, w3_, d3_;
 
@@ -61,6 +60,38 @@ namespace sketch
         int frequency_threshold_;
         std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>> abnormal_events_;
         uint64_t start_time_;
+#ifdef JITTERSKETCH_STATS
+        JitterSketchStats stats_;
+#endif
+
+        // Packets hashed, and their buckets prefetched, ahead of processing
+        // in updateBatch().
+        static constexpr size_t PREFETCH_GROUP = 16;
+
+        struct Slots {
+            uint32_t s1_idx;
+            uint16_t fp;
+            uint32_t s2_idx;
+            uint32_t longFp_val;
+            uint32_t s3_idx;
+        };
+
+        inline Slots slots(uint32_t hash_val) const {
+            Slots s;
+            s.s1_idx = hash_val % w1_;
+            s.fp = (hash_val / w1_) & 0xFFFF;
+            uint32_t hash2 = (hash_val >> 16) | (hash_val << 16);
+            s.s2_idx = hash2 % w2_;
+            s.longFp_val = hash2 / w2_;
+            s.s3_idx = (hash_val ^ hash2) % w3_;
+            return s;
+        }
+
+        inline JitterSketchStageThreeEntry* stageThree(uint32_t s3_idx) {
+            return stage_three_.data() + static_cast<size_t>(s3_idx) * d3_;
+        }
+
+        uint64_t updateAt(const FlowKey<13>& flowkey, uint64_t timestamp, const Slots& slot);
 
     public:
         JitterSketch(int w1, int w2, int w3, int d3, double jitter_factor,
@@ -72,12 +103,21 @@ namespace sketch
         }
         std::string name() override { return "JitterSketch"; }
         size_t size() const override;
-        uint64_t update(const FlowKey<13>& flowkey, uint64_t timestamp) override;
+        uint64_t update(const FlowKey<13>& flowkey, uint64_t timestamp) override {
+            return updateAt(flowkey, timestamp, slots(bob_hash_(flowkey)));
+        }
+        void updateBatch(const core::Record *records, size_t n) override;
         auto clear() -> void override;
 
         const std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>>& getAbnormalEvents() const {
             return abnormal_events_;
         }
+
+#ifdef JITTERSKETCH_STATS
+        const JitterSketchStats& getStats() const {
+            return stats_;
+        }
+#endif
     };
 
     template <typename hash_t>
@@ -88,7 +128,7 @@ namespace sketch
               max_ifpd_diff_(max_ifpd_diff), jitter_detection_mode_(jitter_detection_mode), frequency_threshold_(frequency_threshold - 2) {
         stage_one_.resize(w1, {0, 0});
         stage_two_.resize(w2, {0, 0, 0xFF});
-        stage_three_.resize(w3, JitterSketchStageThreeBucket(d3));
+        stage_three_.resize(static_cast<size_t>(w3) * d3);
     }
 
     template<typename hash_t>
@@ -99,23 +139,43 @@ namespace sketch
                s3_entry_size;
     }
 
+    // Hashes a group of packets and prefetches the buckets each will touch
+    // before processing any of them, so their cache misses overlap instead
+    // of being taken one packet at a time.
     template<typename hash_t>
-    uint64_t JitterSketch<hash_t>::update(const FlowKey<13>& flowkey, uint64_t timestamp) {
-        uint64_t esti_delay = 0;
-
-        uint32_t hash_val = bob_hash_(flowkey);
-        uint32_t s1_idx = hash_val % w1_;
-        uint16_t fp = (hash_val / w1_) & 0xFFFF;
+    void JitterSketch<hash_t>::updateBatch(const core::Record *records, size_t n) {
+        Slots group[PREFETCH_GROUP];
+        for (size_t base = 0; base < n; base += PREFETCH_GROUP) {
+            size_t m = n - base < PREFETCH_GROUP ? n - base : PREFETCH_GROUP;
+            for (size_t i = 0; i < m; ++i) {
+                group[i] = slots(bob_hash_(records[base + i].flowkey_));
+                __builtin_prefetch(&stage_one_[group[i].s1_idx]);
+                __builtin_prefetch(&stage_two_[group[i].s2_idx]);
+                const char* s3 = reinterpret_cast<const char*>(stageThree(group[i].s3_idx));
+                __builtin_prefetch(s3);
+                __builtin_prefetch(s3 + d3_ * sizeof(JitterSketchStageThreeEntry) - 1);
+            }
+            for (size_t i = 0; i < m; ++i) {
+                updateAt(records[base + i].flowkey_, records[base + i].timestamp_, group[i]);
+            }
+        }
+    }
 
-        uint32_t hash2 = (hash_val >> 16) | (hash_val << 16);
-        uint32_t s2_idx = hash2 % w2_;
-        uint32_t longFp_val = hash2 / w2_;
+    template<typename hash_t>
+    uint64_t JitterSketch<hash_t>::updateAt(const FlowKey<13>& flowkey, uint64_t timestamp, const Slots& slot) {
+        uint64_t esti_delay = 0;
 
-        uint32_t hash3 = hash_val ^ (hash2);
-        uint32_t s3_idx = hash3 % w3_;
+        uint32_t s1_idx = slot.s1_idx;
+        uint16_t fp = slot.fp;
+        uint32_t s2_idx = slot.s2_idx;
+        uint32_t longFp_val = slot.longFp_val;
+        uint32_t s3_idx = slot.s3_idx;
 
-        for (auto& entry : stage_three_[s3_idx].entries) {
+        JitterSketchStageThreeEntry* s3_bucket = stageThree(s3_idx);
+        for (int i = 0; i < d3_; ++i) {
+            auto& entry = s3_bucket[i];
             if (entry.fullID == flowkey) {
+                JS_STAT(s3_hits);
                 uint64_t old_ifpd = entry.IFPD;
                 esti_delay = (timestamp > entry.lastArrivalTime) ? (timestamp - entry.lastArrivalTime) : 0;
                 uint64_t diff = std::abs((int64_t)esti_delay - (int64_t)old_ifpd);
@@ -141,6 +201,7 @@ namespace sketch
         bool flag = false;
         JitterSketchStageTwoBucket& s2_bucket = stage_two_[s2_idx];
         if (s2_bucket.longFP == longFp_val) {
+            JS_STAT(s2_hits);
             esti_delay = (timestamp > s2_bucket.lastArrivalTime) ? (timestamp - s2_bucket.lastArrivalTime) : 0;
             uint64_t old_ifpd = s2_bucket.smallIFPD;
 
@@ -157,13 +218,17 @@ namespace sketch
                 flag = true;
             }
 
+            if (esti_delay >= std::numeric_limits<SMALL_TYPE>::max()) {
+                JS_STAT(small_type_overflows);
+            }
             if (esti_delay >= std::numeric_limits<SMALL_TYPE>::max() || flag) {
+                JS_STAT(s2_to_s3);
                 int empty_entry_idx = -1;
                 int replace_idx = -1;
                 double max_idle_index = -1.0;
 
                 for (int i = 0; i < d3_; ++i) {
-                    auto& entry = stage_three_[s3_idx].entries[i];
+                    auto& entry = s3_bucket[i];
                     if (entry.lastArrivalTime == 0) {
                         empty_entry_idx = i;
                         break;
@@ -176,7 +241,12 @@ namespace sketch
                 }
 
                 int target_idx = (empty_entry_idx != -1) ? empty_entry_idx : replace_idx;
-                auto& target_entry = stage_three_[s3_idx].entries[target_idx];
+                if (empty_entry_idx != -1) {
+                    JS_STAT(s3_empty_fills);
+                } else {
+                    JS_STAT(s3_evictions);
+                }
+                auto& target_entry = s3_bucket[target_idx];
                 target_entry.fullID = flowkey;
                 target_entry.lastArrivalTime = timestamp;
                 target_entry.IFPD = esti_delay;
@@ -191,19 +261,27 @@ namespace sketch
 
         JitterSketchStageOneBucket& s1_bucket = stage_one_[s1_idx];
         if (s1_bucket.fp == fp) {
+            JS_STAT(s1_hits);
             s1_bucket.freq++;
             if (s1_bucket.freq > frequency_threshold_) {
+                JS_STAT(s1_to_s2);
+                if (s2_bucket.longFP != 0) {
+                    JS_STAT(s2_fp_collisions);
+                }
                 s2_bucket.longFP = longFp_val;
                 s2_bucket.lastArrivalTime = timestamp;
                 s2_bucket.smallIFPD = std::numeric_limits<SMALL_TYPE>::max();
                 s1_bucket = {0, 0};
             }
         } else if (s1_bucket.freq == 0) {
+            JS_STAT(s1_replacements);
             s1_bucket.fp = fp;
             s1_bucket.freq = 1;
         } else {
+            JS_STAT(s1_decrements);
             s1_bucket.freq--;
             if (s1_bucket.freq == 0) {
+                JS_STAT(s1_replacements);
                 s1_bucket.fp = fp;
                 s1_bucket.freq = 1;
             }
@@ -217,12 +295,11 @@ namespace sketch
     auto JitterSketch<hash_t>::clear() -> void {
         std::fill(stage_one_.begin(), stage_one_.end(), JitterSketchStageOneBucket{0, 0});
         std::fill(stage_two_.begin(), stage_two_.end(), JitterSketchStageTwoBucket{0, 0, 0xFF});
-        for (auto& bucket : stage_three_) {
-            for (auto& entry : bucket.entries) {
-                entry = JitterSketchStageThreeEntry();
-            }
-        }
+        std::fill(stage_three_.begin(), stage_three_.end(), JitterSketchStageThreeEntry());
         abnormal_events_.clear();
+#ifdef JITTERSKETCH_STATS
+        stats_.clear();
+#endif
     }
 }
 
@@ -25,6 +25,13 @@ namespace sketch
                s3_entry_size;
     }
 
+    template<typename hash_t>
+    void JitterSketchS1Opt<hash_t>::updateBatch(const core::Record *records, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            JitterSketchS1Opt::update(records[i].flowkey_, records[i].timestamp_);
+        }
+    }
+
     template<typename hash_t>
     uint64_t JitterSketchS1Opt<hash_t>::update(const FlowKey<13>& flowkey, uint64_t timestamp) {
         uint64_t esti_delay = 0;
@@ -38,6 +45,7 @@ namespace sketch
 
         for (auto& entry : stage_three_[s3_idx].entries) {
             if (entry.fullID == flowkey) {
+                JS_STAT(s3_hits);
                 uint64_t old_ifpd = entry.IFPD;
                 esti_delay = (timestamp > entry.lastArrivalTime) ? (timestamp - entry.lastArrivalTime) : 0;
                 uint64_t diff = std::abs((int64_t)esti_delay - (int64_t)old_ifpd);
@@ -63,6 +71,7 @@ namespace sketch
         bool flag = false;
         JitterSketchS1OptStageTwoBucket& s2_bucket = stage_two_[s2_idx];
         if (s2_bucket.longFP == longFP_val) {
+            JS_STAT(s2_hits);
             esti_delay = (timestamp > s2_bucket.lastArrivalTime) ? (timestamp - s2_bucket.lastArrivalTime) : 0;
             uint64_t old_ifpd = s2_bucket.smallIFPD;
 
@@ -79,7 +88,11 @@ namespace sketch
                 flag = true;
             }
 
+            if (esti_delay >= std::numeric_limits<SMALL_TYPE>::max()) {
+                JS_STAT(small_type_overflows);
+            }
             if (esti_delay >= std::numeric_limits<SMALL_TYPE>::max() || flag) {
+                JS_STAT(s2_to_s3);
                 int empty_entry_idx = -1;
                 int replace_idx = -1;
                 double max_idle_index = -1.0;
@@ -98,6 +111,11 @@ namespace sketch
                 }
 
                 int target_idx = (empty_entry_idx != -1) ? empty_entry_idx : replace_idx;
+                if (empty_entry_idx != -1) {
+                    JS_STAT(s3_empty_fills);
+                } else {
+                    JS_STAT(s3_evictions);
+                }
                 auto& target_entry = stage_three_[s3_idx].entries[target_idx];
                 target_entry.fullID = flowkey;
                 target_entry.lastArrivalTime = timestamp;
@@ -119,8 +137,13 @@ namespace sketch
             uint16_t fp = (hash_val / w1_) & 0xFFFF;
 
             if (stage_one_[s1_idx].fp == fp) {
+                JS_STAT(s1_hits);
                 stage_one_[s1_idx].freq++;
                 if (stage_one_[s1_idx].freq > frequency_threshold_) {
+                    JS_STAT(s1_to_s2);
+                    if (s2_bucket.longFP != 0) {
+                        JS_STAT(s2_fp_collisions);
+                    }
                     s2_bucket.longFP = longFP_val;
                     s2_bucket.lastArrivalTime = timestamp;
                     s2_bucket.smallIFPD = std::numeric_limits<SMALL_TYPE>::max();
@@ -147,6 +170,7 @@ namespace sketch
             if (empty_s1_idx != -1) {
                 uint32_t hash_val = stage_one_hashes_[empty_hash_idx](flowkey);
                 uint16_t fp = (hash_val / w1_) & 0xFFFF;
+                JS_STAT(s1_replacements);
                 stage_one_[empty_s1_idx].fp = fp;
                 stage_one_[empty_s1_idx].freq = 1;
             } else {
@@ -162,6 +186,7 @@ namespace sketch
                 }
 
                 if (min_c_s1_idx != -1) {
+                    JS_STAT(s1_decrements);
                     stage_one_[min_c_s1_idx].freq--;
                 }
             }
@@ -181,6 +206,9 @@ namespace sketch
             }
         }
         abnormal_events_.clear();
+#ifdef JITTERSKETCH_STATS
+        stats_.clear();
+#endif
     }
 
     template class JitterSketchS1Opt<hash::AwareHash>;
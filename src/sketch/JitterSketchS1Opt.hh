@@ -7,6 +7,7 @@
 #include "utils/flowkey.hh"
 #include "utils/hash.hh"
 #include "utils/BOBHash.hh"
+#include "sketch/JitterSketchStats.hh"
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -66,6 +67,9 @@ namespace sketch
 
         std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>> abnormal_events_;
         uint64_t start_time_;
+#ifdef JITTERSKETCH_STATS
+        JitterSketchStats stats_;
+#endif
 
     public:
         JitterSketchS1Opt(int w1, int w2, int w3, int d3, int s1_hash_num, double jitter_factor,
@@ -78,11 +82,18 @@ namespace sketch
         std::string name() override { return "JitterSketch-Opt"; }
         size_t size() const override;
         uint64_t update(const FlowKey<13>& flowkey, uint64_t timestamp) override;
+        void updateBatch(const core::Record *records, size_t n) override;
         auto clear() -> void override;
 
         const std::vector<std::tuple<FlowKey<13>, uint64_t, uint64_t, uint64_t>>& getAbnormalEvents() const {
             return abnormal_events_;
         }
+
+#ifdef JITTERSKETCH_STATS
+        const JitterSketchStats& getStats() const {
+            return stats_;
+        }
+#endif
     };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef SKETCH_JITTERSKETCHSTATS_HH
+#define SKETCH_JITTERSKETCHSTATS_HH
+
+#include <cstdint>
+#include <cstdio>
+
+// Internal stage-transition counters for JitterSketch and JitterSketchS1Opt.
+// Enabled with -DJITTERSKETCH_STATS (cmake -DJITTERSKETCH_STATS=ON). When the
+// macro is not defined, JS_STAT() expands to nothing and the sketches carry no
+// counter member, so the default build pays nothing for them.
+//
+// Counters live inside each sketch instance. A sketch is only ever updated by
+// one thread, so per-instance counters are per-shard and never contended.
+
+namespace sketch {
+
+    struct JitterSketchStats {
+        uint64_t s1_hits = 0;             // fingerprint matched in stage one
+        uint64_t s1_decrements = 0;       // mismatch, occupant's counter decremented
+        uint64_t s1_replacements = 0;     // occupant's counter hit zero (or slot empty), key took over
+        uint64_t s1_to_s2 = 0;            // frequency threshold reached, promoted to stage two
+        uint64_t s2_hits = 0;             // long fingerprint matched in stage two
+        uint64_t s2_fp_collisions = 0;    // promotion overwrote a live stage-two bucket of another fingerprint
+        uint64_t s2_to_s3 = 0;            // promoted from stage two to stage three
+        uint64_t s3_hits = 0;             // full flow ID matched in stage three
+        uint64_t s3_empty_fills = 0;      // stage-three promotion into an empty entry
+        uint64_t s3_evictions = 0;        // stage-three promotion evicted the most idle entry
+        uint64_t small_type_overflows = 0;// stage-two IFPD did not fit in SMALL_TYPE
+
+        void clear() { *this = JitterSketchStats(); }
+
+        void print() const {
+            printf(" Stage 1: hits %lu, decrements %lu, replacements %lu, promotions to S2 %lu\n",
+                   s1_hits, s1_decrements, s1_replacements, s1_to_s2);
+            printf(" Stage 2: hits %lu, fp collisions %lu, promotions to S3 %lu, SMALL_TYPE overflows %lu\n",
+                   s2_hits, s2_fp_collisions, s2_to_s3, small_type_overflows);
+            printf(" Stage 3: hits %lu, empty fills %lu, evictions %lu\n",
+                   s3_hits, s3_empty_fills, s3_evictions);
+        }
+    };
+
+} // namespace sketch
+
+#ifdef JITTERSKETCH_STATS
+#define JS_STAT(field) (++stats_.field)
+#else
+#define JS_STAT(field) ((void)0)
+#endif
+
+#endif // SKETCH_JITTERSKETCHSTATS_HH
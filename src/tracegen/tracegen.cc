@@ -0,0 +1,449 @@
+// Synthetic trace generator with injected jitter and labelled ground truth.
+//
+//   tracegen <settings.conf> <out.dat> [--labels out.bin] [--flows N]
+//            [--packets N] [--zipf S] [--duration S] [--jitter-flows F]
+//            [--factor F] [--mode 0|1|2] [--noise F] [--threads N]
+//            [--seed N] [--mem-mb N]
+//
+// Writes a trace in the 22-byte record format main reads. Flow sizes are
+// Zipf(S) over N flows, scaled to about --packets packets. Each flow sends
+// periodically over --duration seconds, with a random phase and per-packet
+// noise of +-noise/2 of its period. A --jitter-flows fraction of the flows
+// with at least 8 packets gets one jitter episode: from a packet in the
+// second quarter of the flow, the period is multiplied (deceleration) or
+// divided (acceleration) by --factor for up to a quarter of the flow, then
+// returns to normal. --mode picks the kind as in jitter_detection_mode.
+//
+// The labels are the episode onsets and recoveries that the exact detector
+// reports under the [general] detection parameters of settings.conf. They
+// are computed from the written timestamps and the frequency threshold
+// exactly as GroundTruthDetector would compute them. They are written in
+// the ground-truth cache format, keyed by the trace digest, so main uses
+// them through [general] truth_labels (with shuffle_flow_keys = false)
+// instead of running the exact detector. Labels need noise below
+// (jitter_factor - 1) / (jitter_factor + 1), so that the noise itself never
+// triggers an event; larger noise is rejected when --labels is given.
+//
+// Nothing is stored per flow: a flow's parameters, and the timestamp of
+// its k-th packet, are pure functions of (seed, flow index, k). The time
+// axis is cut into rounds sized to --mem-mb. In each round every thread
+// emits the packets of its own flows that fall in the round and sorts
+// them, and the sorted runs are merged into the output file. The output
+// does not depend on --threads.
+
+#include "detector/GroundTruthCache.hh"
+#include "utils/core.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    struct Options {
+        std::string labels;
+        uint64_t flows = 100000;
+        uint64_t packets = 10000000;
+        double zipf = 1.0;
+        double duration = 60.0;      // seconds
+        double jitter_flows = 0.05;
+        double factor = 8.0;
+        int mode = 2;
+        double noise = 0.1;
+        unsigned threads = 0;
+        uint64_t seed = 1;
+        uint64_t mem_mb = 1024;
+    };
+
+    // Detection parameters the labels are computed for.
+    struct Detection {
+        double jitter_factor;
+        uint64_t min_absolute_jitter_thres;
+        uint64_t max_ifpd_diff;
+        int jitter_detection_mode;
+        int frequency_threshold;
+    };
+
+    inline uint64_t splitmix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    inline double unit(uint64_t x) {
+        return (x >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // One flow, derived from (seed, index).
+    struct Flow {
+        uint64_t index;
+        uint64_t rng;
+        uint64_t n;             // packets
+        double period;          // seconds
+        double phase;
+        double episode_period;  // during the episode
+        uint64_t onset;         // first packet sent after an episode gap, 0 = no episode
+        uint64_t recovery;      // first packet sent after a normal gap again
+        double noise;           // amplitude, seconds
+
+        // Noise-free send time of packet k.
+        double base(uint64_t k) const {
+            if (onset == 0 || k < onset) {
+                return phase + k * period;
+            }
+            double t = phase + (onset - 1) * period;
+            if (k < recovery) {
+                return t + (k - onset + 1) * episode_period;
+            }
+            return t + (recovery - onset) * episode_period + (k - recovery + 1) * period;
+        }
+
+        double ts(uint64_t k) const {
+            return base(k) + (unit(splitmix(rng ^ k)) - 0.5) * noise;
+        }
+
+        // Timestamp as main loads it: microseconds, truncated.
+        uint64_t tsUs(uint64_t k) const {
+            return static_cast<uint64_t>(ts(k) * 1000000);
+        }
+
+        // First packet sent at or after t.
+        uint64_t firstAtOrAfter(double t) const {
+            double episode_start = phase + (onset == 0 ? 0 : (onset - 1) * period);
+            double episode_end = episode_start + (onset == 0 ? 0 : (recovery - onset) * episode_period);
+            double k;
+            if (onset == 0 || t <= episode_start) {
+                k = (t - phase) / period;
+            } else if (t <= episode_end) {
+                k = (onset - 1) + (t - episode_start) / episode_period;
+            } else {
+                k = (recovery - 1) + (t - episode_end) / period;
+            }
+            // Noise is under half a gap, so the estimate is off by at most one.
+            uint64_t first = k > 1 ? static_cast<uint64_t>(k) - 1 : 0;
+            while (first < n && ts(first) < t) {
+                ++first;
+            }
+            return first;
+        }
+
+        FlowKey<13> key() const {
+            // splitmix is a bijection, so distinct flows get distinct address pairs.
+            uint64_t addr = splitmix(index ^ 0x5DEECE66DULL);
+            uint64_t ports = splitmix(addr);
+            return FlowKey<13>(static_cast<uint32_t>(addr), static_cast<uint32_t>(addr >> 32),
+                               static_cast<uint16_t>(ports), static_cast<uint16_t>(ports >> 16),
+                               (ports >> 32) & 1 ? 6 : 17);
+        }
+    };
+
+    class Model {
+    public:
+        Options opt;
+        double harmonic = 0;    // sum of (i+1)^-zipf
+
+        Flow flow(uint64_t i) const {
+            Flow f;
+            f.index = i;
+            f.rng = splitmix(opt.seed * 0xD1B54A32D192ED03ULL + i);
+            double share = opt.packets * std::pow(static_cast<double>(i + 1), -opt.zipf) / harmonic;
+            f.n = std::max<uint64_t>(1, static_cast<uint64_t>(std::llround(share)));
+            f.period = opt.duration / f.n;
+            f.onset = 0;
+            f.recovery = 0;
+            f.episode_period = f.period;
+
+            uint64_t r = splitmix(f.rng);
+            if (f.n >= 8 && unit(r) < opt.jitter_flows) {
+                bool decelerate = opt.mode == 0 || (opt.mode == 2 && (splitmix(r) & 1));
+                f.episode_period = decelerate ? f.period * opt.factor : f.period / opt.factor;
+                f.onset = f.n / 4 + static_cast<uint64_t>(unit(splitmix(r + 1)) * (f.n / 4)) + 1;
+                f.recovery = f.onset + std::max<uint64_t>(1, static_cast<uint64_t>(unit(splitmix(r + 2)) * (f.n / 4)));
+            }
+            f.noise = opt.noise * std::min(f.period, f.episode_period);
+            f.phase = f.noise + unit(splitmix(r + 3)) * f.period;
+            return f;
+        }
+    };
+
+    struct Packet {
+        double ts;
+        uint64_t flow;
+
+        bool operator<(const Packet &other) const {
+            return ts < other.ts || (ts == other.ts && flow < other.flow);
+        }
+    };
+
+    struct Label {
+        double ts;
+        uint64_t flow;
+        GroundTruthCache::Event event;
+    };
+
+    // The event GroundTruthDetector reports at packet k of f, if any.
+    bool labelAt(const Flow &f, uint64_t k, const Detection &d, Label &label) {
+        if (k < 2 || k >= f.n || k < static_cast<uint64_t>(std::max(0, d.frequency_threshold))) {
+            return false;
+        }
+        uint64_t old_ifpd = f.tsUs(k - 1) - f.tsUs(k - 2);
+        uint64_t new_ifpd = f.tsUs(k) - f.tsUs(k - 1);
+        uint64_t diff = std::abs(static_cast<int64_t>(new_ifpd) - static_cast<int64_t>(old_ifpd));
+        bool deceleration = old_ifpd > 0 && new_ifpd > d.jitter_factor * old_ifpd;
+        bool acceleration = new_ifpd > 0 && old_ifpd > d.jitter_factor * new_ifpd;
+        bool report = (d.jitter_detection_mode == 0 && deceleration) ||
+                      (d.jitter_detection_mode == 1 && acceleration) ||
+                      (d.jitter_detection_mode == 2 && (deceleration || acceleration));
+        if (!report || diff <= d.min_absolute_jitter_thres || diff >= d.max_ifpd_diff) {
+            return false;
+        }
+        label.ts = f.ts(k);
+        label.flow = f.index;
+        label.event = GroundTruthCache::Event(f.key(), old_ifpd, new_ifpd, f.tsUs(k));
+        return true;
+    }
+
+    template <typename fn_t>
+    void parallelFor(unsigned threads, fn_t &&fn) {
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) {
+            workers.emplace_back(fn, t);
+        }
+        fn(0);
+        for (auto &w : workers) {
+            w.join();
+        }
+    }
+
+    void putRecord(char *out, const FlowKey<13> &key, double ts) {
+        // Same layout load_records reads: 13-byte 5-tuple, double seconds, flag.
+        std::memcpy(out, key.cKey(), 13);
+        std::memcpy(out + 13, &ts, sizeof(double));
+        out[21] = 0;
+    }
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <settings.conf> <out.dat> [--labels out.bin] [--flows N] [--packets N] "
+                        "[--zipf S] [--duration S] [--jitter-flows F] [--factor F] [--mode 0|1|2] [--noise F] "
+                        "[--threads N] [--seed N] [--mem-mb N]\n", argv[0]);
+        return 1;
+    }
+    auto config = core::load_settings(argv[1]);
+    if (!config || config->ParseError() < 0) {
+        fprintf(stderr, "Can't load '%s'\n", argv[1]);
+        return 1;
+    }
+    std::string out_path = argv[2];
+
+    Model model;
+    Options &opt = model.opt;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--labels") {
+            opt.labels = value;
+        } else if (flag == "--flows") {
+            opt.flows = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (flag == "--packets") {
+            opt.packets = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (flag == "--zipf") {
+            opt.zipf = std::atof(value.c_str());
+        } else if (flag == "--duration") {
+            opt.duration = std::atof(value.c_str());
+        } else if (flag == "--jitter-flows") {
+            opt.jitter_flows = std::atof(value.c_str());
+        } else if (flag == "--factor") {
+            opt.factor = std::atof(value.c_str());
+        } else if (flag == "--mode") {
+            opt.mode = std::atoi(value.c_str());
+        } else if (flag == "--noise") {
+            opt.noise = std::atof(value.c_str());
+        } else if (flag == "--threads") {
+            opt.threads = static_cast<unsigned>(std::atoi(value.c_str()));
+        } else if (flag == "--seed") {
+            opt.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (flag == "--mem-mb") {
+            opt.mem_mb = std::max<uint64_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", flag.c_str());
+            return 1;
+        }
+    }
+    if (opt.flows == 0 || opt.packets == 0 || opt.duration <= 0 || opt.factor <= 1 || opt.mode < 0 ||
+        opt.mode > 2 || opt.noise < 0 || opt.noise >= 1) {
+        fprintf(stderr, "Need flows, packets, duration > 0, factor > 1, mode 0-2 and 0 <= noise < 1\n");
+        return 1;
+    }
+    unsigned threads = opt.threads ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    Detection detection;
+    detection.jitter_factor = config->GetReal("general", "jitter_factor", 2.0);
+    detection.min_absolute_jitter_thres = config->GetInteger("general", "min_absolute_jitter_thres", 500);
+    detection.max_ifpd_diff = config->GetInteger("general", "max_ifpd_diff", 1000000);
+    detection.jitter_detection_mode = config->GetInteger("general", "jitter_detection_mode", 2);
+    detection.frequency_threshold = config->GetInteger("general", "frequency_threshold", 30);
+
+    // Every gap at period p lies within p * (1 +- noise), so noise alone
+    // reaches an IFPD ratio of (1 + noise) / (1 - noise).
+    // At the jitter factor the exact detector would report events that the
+    // labels, which only cover episode onsets and recoveries, leave out.
+    double max_noise = (detection.jitter_factor - 1) / (detection.jitter_factor + 1);
+    if (!opt.labels.empty() && opt.noise >= max_noise) {
+        fprintf(stderr, "--noise %g can trigger jitter events by itself at jitter_factor %g; labels need noise < %g\n",
+                opt.noise, detection.jitter_factor, max_noise);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Pass 1: Zipf normalisation.
+    std::vector<double> partial_sum(threads, 0);
+    parallelFor(threads, [&](unsigned t) {
+        for (uint64_t i = opt.flows * t / threads; i < opt.flows * (t + 1) / threads; ++i) {
+            partial_sum[t] += std::pow(static_cast<double>(i + 1), -opt.zipf);
+        }
+    });
+    for (double s : partial_sum) {
+        model.harmonic += s;
+    }
+
+    // Pass 2: packet count, time span and labels.
+    std::vector<uint64_t> partial_packets(threads, 0);
+    std::vector<double> partial_end(threads, 0);
+    std::vector<std::vector<Label>> partial_labels(threads);
+    parallelFor(threads, [&](unsigned t) {
+        for (uint64_t i = opt.flows * t / threads; i < opt.flows * (t + 1) / threads; ++i) {
+            Flow f = model.flow(i);
+            partial_packets[t] += f.n;
+            partial_end[t] = std::max(partial_end[t], f.ts(f.n - 1));
+            Label label;
+            if (f.onset && labelAt(f, f.onset, detection, label)) {
+                partial_labels[t].push_back(label);
+            }
+            if (f.onset && labelAt(f, f.recovery, detection, label)) {
+                partial_labels[t].push_back(label);
+            }
+        }
+    });
+    uint64_t total = 0;
+    double end = 0;
+    std::vector<Label> labels;
+    for (unsigned t = 0; t < threads; ++t) {
+        total += partial_packets[t];
+        end = std::max(end, partial_end[t]);
+        labels.insert(labels.end(), partial_labels[t].begin(), partial_labels[t].end());
+    }
+    // Trace order, as GroundTruthDetector emits them.
+    std::sort(labels.begin(), labels.end(), [](const Label &a, const Label &b) {
+        return a.ts < b.ts || (a.ts == b.ts && a.flow < b.flow);
+    });
+
+    // Pass 3: rounds over the time axis.
+    uint64_t budget = opt.mem_mb << 20;
+    uint64_t rounds = std::max<uint64_t>(1, (total * sizeof(Packet) + budget - 1) / budget);
+    fprintf(stderr, "%llu flows, %llu packets over %.2f s, %zu labels, %llu rounds on %u threads\n",
+            static_cast<unsigned long long>(opt.flows), static_cast<unsigned long long>(total), end, labels.size(),
+            static_cast<unsigned long long>(rounds), threads);
+
+    FILE *out = fopen(out_path.c_str(), "wb");
+    if (!out) {
+        fprintf(stderr, "Can't write '%s'\n", out_path.c_str());
+        return 1;
+    }
+    std::vector<char> buffer(core::DATA_T_SIZE * 65536);
+    size_t buffered = 0;
+    uint64_t written = 0;
+    uint64_t digest = GroundTruthCache::traceDigestBegin(total);
+    bool ok = true;
+
+    std::vector<std::vector<Packet>> runs(threads);
+    for (uint64_t r = 0; r < rounds && ok; ++r) {
+        double t0 = end * r / rounds;
+        double t1 = r + 1 == rounds ? HUGE_VAL : end * (r + 1) / rounds;
+        parallelFor(threads, [&](unsigned t) {
+            std::vector<Packet> &run = runs[t];
+            run.clear();
+            for (uint64_t i = opt.flows * t / threads; i < opt.flows * (t + 1) / threads; ++i) {
+                Flow f = model.flow(i);
+                for (uint64_t k = r == 0 ? 0 : f.firstAtOrAfter(t0); k < f.n; ++k) {
+                    double ts = f.ts(k);
+                    if (ts >= t1) {
+                        break;
+                    }
+                    run.push_back({ts, i});
+                }
+            }
+            std::sort(run.begin(), run.end());
+        });
+
+        // k-way merge of the sorted runs into the file.
+        using Head = std::pair<Packet, unsigned>;
+        auto later = [](const Head &a, const Head &b) { return b.first < a.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+        std::vector<size_t> pos(threads, 0);
+        for (unsigned t = 0; t < threads; ++t) {
+            if (!runs[t].empty()) {
+                heads.push({runs[t][0], t});
+            }
+        }
+        while (!heads.empty()) {
+            Head head = heads.top();
+            heads.pop();
+            unsigned t = head.second;
+            if (++pos[t] < runs[t].size()) {
+                heads.push({runs[t][pos[t]], t});
+            }
+
+            FlowKey<13> key = model.flow(head.first.flow).key();
+            putRecord(&buffer[buffered * core::DATA_T_SIZE], key, head.first.ts);
+            digest = GroundTruthCache::traceDigestAdd(digest, key, static_cast<uint64_t>(head.first.ts * 1000000));
+            if (++buffered * core::DATA_T_SIZE == buffer.size()) {
+                ok = ok && fwrite(buffer.data(), core::DATA_T_SIZE, buffered, out) == buffered;
+                written += buffered;
+                buffered = 0;
+            }
+        }
+        fprintf(stderr, "round %llu/%llu\n", static_cast<unsigned long long>(r + 1),
+                static_cast<unsigned long long>(rounds));
+    }
+    ok = ok && (buffered == 0 || fwrite(buffer.data(), core::DATA_T_SIZE, buffered, out) == buffered);
+    written += buffered;
+    ok = (fclose(out) == 0) && ok;
+    if (!ok || written != total) {
+        fprintf(stderr, "Failed writing '%s'\n", out_path.c_str());
+        return 1;
+    }
+
+    if (!opt.labels.empty()) {
+        GroundTruthCache::Key key;
+        key.trace_digest = digest;
+        key.num_records = total;
+        key.jitter_factor = detection.jitter_factor;
+        key.min_absolute_jitter_thres = detection.min_absolute_jitter_thres;
+        key.max_ifpd_diff = detection.max_ifpd_diff;
+        key.jitter_detection_mode = detection.jitter_detection_mode;
+        key.frequency_threshold = detection.frequency_threshold;
+        std::vector<GroundTruthCache::Event> events;
+        events.reserve(labels.size());
+        for (const auto &label : labels) {
+            events.push_back(label.event);
+        }
+        if (!GroundTruthCache::writeFile(opt.labels, key, events, opt.flows)) {
+            return 1;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "Wrote %llu packets to %s in %.2f s (%.2f Mpps)\n", static_cast<unsigned long long>(total),
+            out_path.c_str(), seconds, total / seconds / 1e6);
+    return 0;
+}
@@ -151,8 +151,18 @@ namespace hash {
         srand((unsigned)time(NULL));
     }
 
+    namespace {
+        thread_local bool seeded = false;
+        thread_local unsigned int seed_state = 0;
+    }
+
+    void BOBHash32::reseed(uint32_t seed) {
+        seeded = true;
+        seed_state = seed;
+    }
+
     BOBHash32::BOBHash32() noexcept {
-        prime32Num_ = rand() % MAX_PRIME32;
+        prime32Num_ = (seeded ? rand_r(&seed_state) : rand()) % MAX_PRIME32;
     }
 
     BOBHash32::~BOBHash32() noexcept {}
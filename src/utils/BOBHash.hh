@@ -21,6 +21,11 @@ namespace hash {
     public:
         static void random_seed();
 
+        // Instances constructed on this thread afterwards pick their prime
+        // from a sequence seeded by seed instead of the shared rand(), so
+        // they don't depend on what was constructed before or elsewhere.
+        static void reseed(uint32_t seed);
+
         // Declarations only
         BOBHash32() noexcept;
         ~BOBHash32() noexcept;
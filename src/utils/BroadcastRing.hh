@@ -0,0 +1,158 @@
+#ifndef COMMON_BROADCASTRING_HH
+#define COMMON_BROADCASTRING_HH
+
+#include "utils/aligned.hh"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace core {
+
+    // Single-producer ring whose every slot is read by every consumer.
+    //
+    // The producer fills slots in place (claim(), then publish()), so slot
+    // buffers are allocated once and reused. Each consumer has its own read
+    // cursor and goes at its own pace (peek(), then release()). A slot can be
+    // refilled only after the slowest consumer has released it. When the
+    // ring is full, claim() waits: the slowest consumer sets the pace. Waits
+    // spin briefly and then yield. Cursors sit on separate cache lines so
+    // consumers don't false-share. Each consumer counts how often it found
+    // the ring empty and the producer counts how often it found it full,
+    // which shows who is holding up the pipeline.
+    template <typename T>
+    class BroadcastRing {
+    private:
+        // Padded rather than aligned: C++14 new[] ignores over-alignment,
+        // and two line sizes apart keeps neighbouring cursors off each
+        // other's line whatever the start address.
+        struct Cursor {
+            std::atomic<uint64_t> pos{0};
+            uint64_t waits = 0;         // times the owner found nothing to do
+            char pad[2 * CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>) - sizeof(uint64_t)];
+        };
+
+        static constexpr int SPIN_LIMIT = 64;
+
+        std::vector<T> slots_;
+        uint64_t mask_;
+        Cursor head_;                   // next slot the producer publishes
+        std::unique_ptr<Cursor[]> tails_;
+        size_t num_consumers_;
+        std::atomic<bool> closed_{false};
+
+        static void pause(int &spins) {
+            if (++spins > SPIN_LIMIT) {
+                std::this_thread::yield();
+            }
+        }
+
+        uint64_t slowest() const {
+            uint64_t min = tails_[0].pos.load(std::memory_order_acquire);
+            for (size_t c = 1; c < num_consumers_; ++c) {
+                uint64_t pos = tails_[c].pos.load(std::memory_order_acquire);
+                if (pos < min) {
+                    min = pos;
+                }
+            }
+            return min;
+        }
+
+    public:
+        // capacity is rounded up to a power of two.
+        BroadcastRing(size_t capacity, size_t num_consumers)
+                : tails_(new Cursor[num_consumers > 0 ? num_consumers : 1]),
+                  num_consumers_(num_consumers > 0 ? num_consumers : 1) {
+            size_t n = 1;
+            while (n < capacity) {
+                n <<= 1;
+            }
+            slots_.resize(n);
+            mask_ = n - 1;
+        }
+
+        BroadcastRing(const BroadcastRing &) = delete;
+        BroadcastRing &operator=(const BroadcastRing &) = delete;
+
+        size_t capacity() const { return slots_.size(); }
+        size_t consumers() const { return num_consumers_; }
+
+        // Every slot, for sizing buffers before the producer starts.
+        std::vector<T> &slots() { return slots_; }
+
+        // Producer: the next free slot, once every consumer is done with it.
+        T &claim() {
+            uint64_t head = head_.pos.load(std::memory_order_relaxed);
+            if (head - slowest() >= slots_.size()) {
+                ++head_.waits;
+                int spins = 0;
+                while (head - slowest() >= slots_.size()) {
+                    pause(spins);
+                }
+            }
+            return slots_[head & mask_];
+        }
+
+        // Producer: like claim(), but returns nullptr instead of waiting, for
+        // sources that drop on overload rather than push back.
+        T *tryClaim() {
+            uint64_t head = head_.pos.load(std::memory_order_relaxed);
+            if (head - slowest() >= slots_.size()) {
+                ++head_.waits;
+                return nullptr;
+            }
+            return &slots_[head & mask_];
+        }
+
+        // Producer: slots published but not yet released by every consumer.
+        size_t backlog() const {
+            return static_cast<size_t>(head_.pos.load(std::memory_order_relaxed) - slowest());
+        }
+
+        // Producer: makes the claimed slot visible to the consumers.
+        void publish() {
+            head_.pos.store(head_.pos.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Producer: no more slots will be published.
+        void close() {
+            closed_.store(true, std::memory_order_release);
+        }
+
+        // Consumer c: the next published slot, or nullptr once the ring is
+        // closed and c has read everything.
+        const T *peek(size_t c) {
+            Cursor &tail = tails_[c];
+            uint64_t pos = tail.pos.load(std::memory_order_relaxed);
+            if (head_.pos.load(std::memory_order_acquire) == pos) {
+                ++tail.waits;
+                int spins = 0;
+                while (head_.pos.load(std::memory_order_acquire) == pos) {
+                    if (closed_.load(std::memory_order_acquire)) {
+                        // publish() happens before close(): check once more.
+                        if (head_.pos.load(std::memory_order_acquire) == pos) {
+                            return nullptr;
+                        }
+                        break;
+                    }
+                    pause(spins);
+                }
+            }
+            return &slots_[pos & mask_];
+        }
+
+        // Consumer c: done with the slot returned by peek(c).
+        void release(size_t c) {
+            Cursor &tail = tails_[c];
+            tail.pos.store(tail.pos.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        uint64_t producerWaits() const { return head_.waits; }
+        uint64_t consumerWaits(size_t c) const { return tails_[c].waits; }
+    };
+
+} // namespace core
+
+#endif // COMMON_BROADCASTRING_HH
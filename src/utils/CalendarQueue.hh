@@ -0,0 +1,215 @@
+#ifndef COMMON_CALENDARQUEUE_HH
+#define COMMON_CALENDARQUEUE_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace core {
+
+    // Calendar queue (R. Brown, CACM 1988): a priority queue of timed
+    // events for a clock that only moves forward.
+    //
+    // Events hash by time into a ring of buckets, each one bucket width
+    // wide, and every bucket is a short list kept in time order. Popping
+    // walks the ring from the current bucket, taking the head of a bucket
+    // only if it falls in the current lap; a full lap with nothing due falls
+    // back to a direct search for the earliest head. The bucket count
+    // doubles when there are more than two events per bucket and halves
+    // below one per two buckets, and each resize sets the width from the
+    // spacing of the earliest queued events, so the buckets about to be
+    // dequeued hold a few events each and push and pop stay O(1) on average
+    // however many events are queued. Events with equal times pop in push
+    // order.
+    //
+    // Times pushed must not be earlier than the last one popped. Nodes come
+    // from one pool with a free list, so a queue that has reached its peak
+    // size allocates nothing more.
+    template <typename T>
+    class CalendarQueue {
+    private:
+        static constexpr size_t MIN_BUCKETS = 16;
+        static constexpr size_t SAMPLE = 25;
+
+        struct Node {
+            uint64_t time;
+            T value;
+            int next;
+        };
+
+        std::vector<Node> nodes_;
+        int free_ = -1;
+        std::vector<int> buckets_;
+        std::vector<int> tails_;
+        size_t mask_;
+        uint64_t width_;
+        size_t size_ = 0;
+        size_t cur_ = 0;            // bucket the next pop starts from
+        uint64_t lap_end_;          // end of cur_'s window in the current lap
+        uint64_t last_ = 0;         // time of the last pop
+        uint64_t resizes_ = 0;
+
+        int newNode(uint64_t time, const T &value) {
+            int n;
+            if (free_ != -1) {
+                n = free_;
+                free_ = nodes_[n].next;
+                nodes_[n].time = time;
+                nodes_[n].value = value;
+            } else {
+                n = static_cast<int>(nodes_.size());
+                nodes_.push_back(Node{time, value, -1});
+            }
+            return n;
+        }
+
+        // Links node n into its bucket after any events at the same time.
+        // Events mostly arrive in time order, so the tail is checked first.
+        void insert(int n) {
+            uint64_t time = nodes_[n].time;
+            size_t b = (time / width_) & mask_;
+            int tail = tails_[b];
+            if (tail == -1 || nodes_[tail].time <= time) {
+                nodes_[n].next = -1;
+                (tail != -1 ? nodes_[tail].next : buckets_[b]) = n;
+                tails_[b] = n;
+                return;
+            }
+            int *link = &buckets_[b];
+            while (nodes_[*link].time <= time) {
+                link = &nodes_[*link].next;
+            }
+            nodes_[n].next = *link;
+            *link = n;
+        }
+
+        void seek(uint64_t time) {
+            cur_ = (time / width_) & mask_;
+            lap_end_ = (time / width_ + 1) * width_;
+        }
+
+        // Three times the mean separation of the next SAMPLE events, leaving
+        // out separations over twice the mean, as Brown does: the width
+        // fits the events about to be dequeued, not a long tail far ahead.
+        // It is kept wide enough for one lap of the new ring to span every
+        // queued event, so no pop has to walk past buckets of later laps.
+        void retune(std::vector<uint64_t> &times, size_t buckets) {
+            size_t k = times.size() < SAMPLE ? times.size() : SAMPLE;
+            if (k < 2) {
+                return;
+            }
+            auto range = std::minmax_element(times.begin(), times.end());
+            uint64_t lap_width = (*range.second - *range.first) / buckets + 1;
+            std::partial_sort(times.begin(), times.begin() + k, times.end());
+            double mean = static_cast<double>(times[k - 1] - times[0]) / (k - 1);
+            double sum = 0;
+            size_t gaps = 0;
+            for (size_t i = 1; i < k; ++i) {
+                uint64_t gap = times[i] - times[i - 1];
+                if (gap <= 2 * mean) {
+                    sum += gap;
+                    ++gaps;
+                }
+            }
+            uint64_t width = gaps > 0 ? static_cast<uint64_t>(3 * sum / gaps) : 0;
+            width_ = width > lap_width ? width : lap_width;
+        }
+
+        void resize(size_t buckets) {
+            std::vector<int> live;
+            std::vector<uint64_t> times;
+            live.reserve(size_);
+            times.reserve(size_);
+            for (int head : buckets_) {
+                for (int n = head; n != -1; n = nodes_[n].next) {
+                    live.push_back(n);
+                    times.push_back(nodes_[n].time);
+                }
+            }
+            retune(times, buckets);
+            buckets_.assign(buckets, -1);
+            tails_.assign(buckets, -1);
+            mask_ = buckets - 1;
+            // Equal times share a bucket, in push order, and insert() puts
+            // each after the ones already there.
+            for (int n : live) {
+                insert(n);
+            }
+            seek(last_);
+            ++resizes_;
+        }
+
+        // Positions cur_ on the bucket holding the earliest event.
+        int locate() {
+            for (size_t i = 0; i <= mask_; ++i) {
+                int head = buckets_[cur_];
+                if (head != -1 && nodes_[head].time < lap_end_) {
+                    return head;
+                }
+                cur_ = (cur_ + 1) & mask_;
+                lap_end_ += width_;
+            }
+            int best = -1;
+            for (int head : buckets_) {
+                if (head != -1 && (best == -1 || nodes_[head].time < nodes_[best].time)) {
+                    best = head;
+                }
+            }
+            seek(nodes_[best].time);
+            return best;
+        }
+
+    public:
+        explicit CalendarQueue(uint64_t width = 1)
+                : buckets_(MIN_BUCKETS, -1), tails_(MIN_BUCKETS, -1), mask_(MIN_BUCKETS - 1),
+                  width_(width > 0 ? width : 1) {
+            seek(0);
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        size_t buckets() const { return buckets_.size(); }
+        uint64_t width() const { return width_; }
+        uint64_t resizes() const { return resizes_; }
+
+        void push(uint64_t time, const T &value) {
+            insert(newNode(time, value));
+            // topTime() may have moved the cursor past empty buckets.
+            if (time < lap_end_ - width_) {
+                seek(time);
+            }
+            if (++size_ > 2 * buckets_.size()) {
+                resize(2 * buckets_.size());
+            }
+        }
+
+        // Time of the earliest event; the queue must not be empty.
+        uint64_t topTime() {
+            return nodes_[locate()].time;
+        }
+
+        // Removes the earliest event; the queue must not be empty.
+        T pop(uint64_t *time = nullptr) {
+            int n = locate();
+            buckets_[cur_] = nodes_[n].next;
+            if (buckets_[cur_] == -1) {
+                tails_[cur_] = -1;
+            }
+            last_ = nodes_[n].time;
+            if (time) {
+                *time = last_;
+            }
+            T value = nodes_[n].value;
+            nodes_[n].next = free_;
+            free_ = n;
+            if (--size_ * 2 < buckets_.size() && buckets_.size() > MIN_BUCKETS) {
+                resize(buckets_.size() / 2);
+            }
+            return value;
+        }
+    };
+
+} // namespace core
+
+#endif // COMMON_CALENDARQUEUE_HH
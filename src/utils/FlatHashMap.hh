@@ -0,0 +1,151 @@
+#ifndef COMMON_FLATHASHMAP_HH
+#define COMMON_FLATHASHMAP_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace core {
+
+    // Open-addressing hash map with linear probing over one flat slot array.
+    // Capacity is a power of two and doubles past 70% load; erase uses
+    // backward-shift deletion, so there are no tombstones. Pointers returned
+    // by find()/findOrInsert() are invalidated by the next insert or erase.
+    template <typename key_t, typename value_t, typename hasher_t>
+    class FlatHashMap {
+    private:
+        struct Slot {
+            key_t key;
+            value_t value;
+            bool used;
+        };
+
+        std::vector<Slot> slots_;
+        size_t mask_;
+        size_t size_;
+        hasher_t hasher_;
+
+        inline size_t home(const key_t &key) const {
+            return static_cast<size_t>(hasher_(key)) & mask_;
+        }
+
+        void grow() {
+            std::vector<Slot> old;
+            old.swap(slots_);
+            slots_.assign(old.size() * 2, Slot{key_t(), value_t(), false});
+            mask_ = slots_.size() - 1;
+            size_ = 0;
+            for (auto &slot : old) {
+                if (slot.used) {
+                    *findOrInsert(slot.key).first = std::move(slot.value);
+                }
+            }
+        }
+
+    public:
+        explicit FlatHashMap(size_t expected = 16) : size_(0) {
+            size_t cap = 16;
+            while (cap * 7 < expected * 10) {
+                cap <<= 1;
+            }
+            slots_.assign(cap, Slot{key_t(), value_t(), false});
+            mask_ = cap - 1;
+        }
+
+        value_t *find(const key_t &key) {
+            for (size_t i = home(key);; i = (i + 1) & mask_) {
+                Slot &slot = slots_[i];
+                if (!slot.used) {
+                    return nullptr;
+                }
+                if (slot.key == key) {
+                    return &slot.value;
+                }
+            }
+        }
+
+        const value_t *find(const key_t &key) const {
+            return const_cast<FlatHashMap *>(this)->find(key);
+        }
+
+        // Returns the key's value, default-constructing it if absent, and
+        // whether it was inserted.
+        std::pair<value_t *, bool> findOrInsert(const key_t &key) {
+            if ((size_ + 1) * 10 > slots_.size() * 7) {
+                grow();
+            }
+            for (size_t i = home(key);; i = (i + 1) & mask_) {
+                Slot &slot = slots_[i];
+                if (!slot.used) {
+                    slot.key = key;
+                    slot.value = value_t();
+                    slot.used = true;
+                    ++size_;
+                    return {&slot.value, true};
+                }
+                if (slot.key == key) {
+                    return {&slot.value, false};
+                }
+            }
+        }
+
+        value_t &operator[](const key_t &key) { return *findOrInsert(key).first; }
+
+        bool erase(const key_t &key) {
+            size_t i = home(key);
+            while (true) {
+                if (!slots_[i].used) {
+                    return false;
+                }
+                if (slots_[i].key == key) {
+                    break;
+                }
+                i = (i + 1) & mask_;
+            }
+            // Shift later members of the probe run back into the hole.
+            size_t hole = i;
+            for (size_t j = (i + 1) & mask_; slots_[j].used; j = (j + 1) & mask_) {
+                size_t h = home(slots_[j].key);
+                if (((j - h) & mask_) >= ((j - hole) & mask_)) {
+                    slots_[hole] = std::move(slots_[j]);
+                    hole = j;
+                }
+            }
+            slots_[hole].used = false;
+            --size_;
+            return true;
+        }
+
+        template <typename fn_t>
+        void forEach(fn_t &&fn) const {
+            for (const auto &slot : slots_) {
+                if (slot.used) {
+                    fn(slot.key, slot.value);
+                }
+            }
+        }
+
+        template <typename fn_t>
+        void forEach(fn_t &&fn) {
+            for (auto &slot : slots_) {
+                if (slot.used) {
+                    fn(slot.key, slot.value);
+                }
+            }
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        void clear() {
+            for (auto &slot : slots_) {
+                slot.used = false;
+            }
+            size_ = 0;
+        }
+    };
+
+} // namespace core
+
+#endif // COMMON_FLATHASHMAP_HH
@@ -0,0 +1,107 @@
+#ifndef COMMON_INDEXEDHEAP_HH
+#define COMMON_INDEXEDHEAP_HH
+
+#include <cstddef>
+#include <vector>
+
+namespace core {
+
+    // Binary min-heap over the ids 0..n-1, each present at most once with a
+    // key. A position table makes update() and erase() of any id
+    // O(log n), and top() is the id with the smallest key.
+    template <typename key_t>
+    class IndexedMinHeap {
+    private:
+        std::vector<int> heap_;
+        std::vector<int> pos_;      // -1 when absent
+        std::vector<key_t> key_;
+
+        void place(size_t at, int id) {
+            heap_[at] = id;
+            pos_[id] = static_cast<int>(at);
+        }
+
+        void siftUp(size_t at) {
+            int id = heap_[at];
+            while (at > 0) {
+                size_t parent = (at - 1) / 2;
+                if (!(key_[id] < key_[heap_[parent]])) {
+                    break;
+                }
+                place(at, heap_[parent]);
+                at = parent;
+            }
+            place(at, id);
+        }
+
+        void siftDown(size_t at) {
+            int id = heap_[at];
+            size_t n = heap_.size();
+            while (true) {
+                size_t child = 2 * at + 1;
+                if (child >= n) {
+                    break;
+                }
+                if (child + 1 < n && key_[heap_[child + 1]] < key_[heap_[child]]) {
+                    ++child;
+                }
+                if (!(key_[heap_[child]] < key_[id])) {
+                    break;
+                }
+                place(at, heap_[child]);
+                at = child;
+            }
+            place(at, id);
+        }
+
+    public:
+        explicit IndexedMinHeap(size_t n) : pos_(n, -1), key_(n) {
+            heap_.reserve(n);
+        }
+
+        size_t size() const { return heap_.size(); }
+        bool empty() const { return heap_.empty(); }
+        bool contains(int id) const { return pos_[id] != -1; }
+
+        // The heap must not be empty.
+        int top() const { return heap_.front(); }
+        const key_t &topKey() const { return key_[heap_.front()]; }
+        const key_t &key(int id) const { return key_[id]; }
+
+        // Inserts id, or changes its key if it is already there.
+        void update(int id, const key_t &key) {
+            if (pos_[id] == -1) {
+                key_[id] = key;
+                heap_.push_back(id);
+                siftUp(heap_.size() - 1);
+                return;
+            }
+            bool smaller = key < key_[id];
+            key_[id] = key;
+            if (smaller) {
+                siftUp(pos_[id]);
+            } else {
+                siftDown(pos_[id]);
+            }
+        }
+
+        void erase(int id) {
+            int at = pos_[id];
+            if (at == -1) {
+                return;
+            }
+            pos_[id] = -1;
+            int last = heap_.back();
+            heap_.pop_back();
+            if (last == id) {
+                return;
+            }
+            place(at, last);
+            siftUp(at);
+            siftDown(pos_[last]);
+        }
+    };
+
+} // namespace core
+
+#endif // COMMON_INDEXEDHEAP_HH
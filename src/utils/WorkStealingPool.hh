@@ -0,0 +1,146 @@
+#ifndef COMMON_WORKSTEALINGPOOL_HH
+#define COMMON_WORKSTEALINGPOOL_HH
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core {
+
+    // Fixed set of worker threads that run index ranges with work stealing.
+    //
+    // run(n, fn) deals the indices 0..n-1 out to the workers' deques in
+    // contiguous blocks. A worker takes tasks from the front of its own
+    // deque and, once that is empty, steals from the back of the others', so
+    // a few long tasks (large mem_size jobs, say) don't leave the remaining
+    // workers idle. run() blocks until every task has finished.
+    class WorkStealingPool {
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<size_t> tasks;
+        };
+
+        std::vector<std::thread> threads_;
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        std::function<void(size_t)> fn_;
+        size_t generation_ = 0;
+        size_t pending_ = 0;
+        bool stop_ = false;
+
+        bool take(unsigned self, size_t &task) {
+            {
+                Queue &own = *queues_[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty()) {
+                    task = own.tasks.front();
+                    own.tasks.pop_front();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < queues_.size(); ++i) {
+                Queue &victim = *queues_[(self + i) % queues_.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = victim.tasks.back();
+                    victim.tasks.pop_back();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void worker(unsigned self) {
+            size_t seen = 0;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+                    if (stop_) {
+                        return;
+                    }
+                    seen = generation_;
+                }
+                size_t task;
+                size_t finished = 0;
+                while (take(self, task)) {
+                    fn_(task);
+                    ++finished;
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_ -= finished;
+                if (pending_ == 0) {
+                    done_.notify_all();
+                }
+            }
+        }
+
+    public:
+        explicit WorkStealingPool(unsigned num_threads = 0) {
+            if (num_threads == 0) {
+                num_threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            for (unsigned t = 0; t < num_threads; ++t) {
+                queues_.emplace_back(new Queue());
+            }
+            for (unsigned t = 0; t < num_threads; ++t) {
+                threads_.emplace_back(&WorkStealingPool::worker, this, t);
+            }
+        }
+
+        ~WorkStealingPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (auto &thread : threads_) {
+                thread.join();
+            }
+        }
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+        // Runs fn(i) for every i in [0, n) on the workers.
+        void run(size_t n, std::function<void(size_t)> fn) {
+            if (n == 0) {
+                return;
+            }
+            {
+                // Published before any task: a worker still draining the
+                // previous batch may pick up a new task as soon as it's queued.
+                std::lock_guard<std::mutex> lock(mutex_);
+                fn_ = std::move(fn);
+                pending_ = n;
+            }
+            size_t workers = queues_.size();
+            for (size_t w = 0; w < workers; ++w) {
+                std::lock_guard<std::mutex> lock(queues_[w]->mutex);
+                for (size_t i = n * w / workers; i < n * (w + 1) / workers; ++i) {
+                    queues_[w]->tasks.push_back(i);
+                }
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++generation_;
+            wake_.notify_all();
+            done_.wait(lock, [&]() { return pending_ == 0; });
+            fn_ = nullptr;
+        }
+    };
+
+} // namespace core
+
+#endif // COMMON_WORKSTEALINGPOOL_HH
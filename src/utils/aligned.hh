@@ -0,0 +1,86 @@
+#ifndef COMMON_ALIGNED_HH
+#define COMMON_ALIGNED_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace core {
+
+    constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    // Fixed-size, zero-initialised array of trivially copyable T in a single
+    // cache-line-aligned allocation. C++14 operator new does not honour
+    // over-aligned types, so sketches that lay out buckets per cache line use
+    // this instead of std::vector.
+    template <typename T, std::size_t align = CACHE_LINE_SIZE>
+    class AlignedArray {
+        static_assert(std::is_trivially_copyable<T>::value, "AlignedArray needs a trivially copyable type");
+
+    private:
+        T *data_;
+        std::size_t size_;
+
+        static T *allocate(std::size_t n) {
+            if (n == 0) {
+                return nullptr;
+            }
+            std::size_t bytes = (n * sizeof(T) + align - 1) / align * align;
+            void *p = ::aligned_alloc(align, bytes);
+            if (!p) {
+                throw std::bad_alloc();
+            }
+            std::memset(p, 0, bytes);
+            return static_cast<T *>(p);
+        }
+
+    public:
+        AlignedArray() : data_(nullptr), size_(0) {}
+        explicit AlignedArray(std::size_t n) : data_(allocate(n)), size_(n) {}
+        AlignedArray(const AlignedArray &rhs) : data_(allocate(rhs.size_)), size_(rhs.size_) {
+            if (size_) {
+                std::memcpy(data_, rhs.data_, size_ * sizeof(T));
+            }
+        }
+        AlignedArray(AlignedArray &&rhs) noexcept : data_(rhs.data_), size_(rhs.size_) {
+            rhs.data_ = nullptr;
+            rhs.size_ = 0;
+        }
+        AlignedArray &operator=(AlignedArray rhs) noexcept {
+            swap(rhs);
+            return *this;
+        }
+        ~AlignedArray() { std::free(data_); }
+
+        void swap(AlignedArray &rhs) noexcept {
+            std::swap(data_, rhs.data_);
+            std::swap(size_, rhs.size_);
+        }
+
+        void zero() {
+            if (size_) {
+                std::memset(data_, 0, size_ * sizeof(T));
+            }
+        }
+
+        T &operator[](std::size_t i) { return data_[i]; }
+        const T &operator[](std::size_t i) const { return data_[i]; }
+        T *data() { return data_; }
+        const T *data() const { return data_; }
+        std::size_t size() const { return size_; }
+        std::size_t bytes() const { return size_ * sizeof(T); }
+    };
+
+    // Maps a 32-bit hash uniformly onto [0, n) with a multiply instead of a
+    // division (Lemire's fastrange).
+    inline uint32_t FastRange32(uint32_t hash, uint32_t n) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(hash) * n) >> 32);
+    }
+
+} // namespace core
+
+#endif // COMMON_ALIGNED_HH
@@ -2,6 +2,7 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <cstdlib>
 namespace core {
@@ -32,7 +33,7 @@ namespace core {
 
         return (next_prime - n) > (n - prev_prime) ? prev_prime : next_prime;
     }
-    std::vector<Record> load_records(const std::string path) {
+    std::vector<Record> load_records(const std::string path, bool shuffle_flow_keys) {
         std::vector<Record> vec;
         std::vector<FlowKey<13>> fvec;
         FILE *inputData = fopen(path.c_str(), "rb");
@@ -55,6 +56,9 @@ namespace core {
         }
         printf("Successfully read in %d packets\n", cnt);
         fclose(inputData);
+        if (!shuffle_flow_keys) {
+            return vec;
+        }
         std::sort(fvec.begin(), fvec.end());
         int num_shuffle_blocks = 3;
         auto start_pos = fvec.begin();
@@ -87,4 +91,18 @@ namespace core {
         return config;
     }
 
+    std::vector<std::string> split_list(const std::string &s) {
+        std::vector<std::string> out;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            item.erase(0, item.find_first_not_of(" \t"));
+            item.erase(item.find_last_not_of(" \t") + 1);
+            if (!item.empty()) {
+                out.push_back(item);
+            }
+        }
+        return out;
+    }
+
 } // namespace core
\ No newline at end of file
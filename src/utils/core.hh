@@ -8,6 +8,7 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <string>
 #include <vector>
 #include <set>
 #define SYN(x) (((x)&0x12) == 0x2)
@@ -34,9 +35,14 @@ namespace core {
     bool IsPrime(int n);
     int NextPrime(int n);
     int NearestPrime(int n);
-    std::vector<Record> load_records(const std::string path);
+    // shuffle_flow_keys reassigns flow keys across packets (shuffled in
+    // three blocks of the sorted key list), as the experiments have always
+    // done. Traces with label files need their keys kept as written.
+    std::vector<Record> load_records(const std::string path, bool shuffle_flow_keys = true);
     std::shared_ptr<INIReader> load_settings(std::string config_file);
     std::set<FlowKey<13>> load_answer_set(const std::string &path);
+    // "a, b,c" -> {"a", "b", "c"}: comma-separated config values.
+    std::vector<std::string> split_list(const std::string &s);
     template <typename T> T Mangle(T key) {
         size_t n = sizeof(T);
         char *s = (char *)&key;
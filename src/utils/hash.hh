@@ -5,6 +5,7 @@
 #include <iostream>
 
 #include <cstdint>
+#include <cstring>
 #include <ctime>
 
 namespace hash {
@@ -15,17 +16,29 @@ namespace hash {
         uint64_t hardener;
 
     public:
+        static constexpr uint64_t DEFAULT_SEED = 3407;
+
         static void random_seed() { /*srand((unsigned)time(NULL));*/ srand(113424723); }
+
+        // Instances draw their parameters from a per-thread (seed, index)
+        // sequence. reseed() restarts this thread's sequence, so a detector
+        // built right after it gets the same hashes whichever thread builds
+        // it and whatever was built before.
+        static void reseed(uint64_t seed) {
+            seedState().seed = seed;
+            seedState().index = 0;
+        }
+
         AwareHash() {
             static const int GEN_INIT_MAGIC = 388650253;
             static const int GEN_SCALE_MAGIC = 388650319;
             static const int GEN_HARDENER_MAGIC = 1176845762;
-            static int index = 0;
-            static uint64_t seed = 3407;
+            int &index = seedState().index;
+            uint64_t seed = seedState().seed;
             // random_seed();
             // seed = rand();
-            static AwareHash gen_hash(GEN_INIT_MAGIC, GEN_SCALE_MAGIC,
-                                      GEN_HARDENER_MAGIC);
+            static const AwareHash gen_hash(GEN_INIT_MAGIC, GEN_SCALE_MAGIC,
+                                            GEN_HARDENER_MAGIC);
 
             uint64_t mangled;
             mangled = core::Mangle(seed + (index++));
@@ -58,6 +71,42 @@ namespace hash {
         bool operator==(const AwareHash &rhs) {
             return init == rhs.init && scale == rhs.scale && hardener == rhs.hardener;
         }
+
+    private:
+        struct SeedState {
+            uint64_t seed = DEFAULT_SEED;
+            int index = 0;
+        };
+        static SeedState &seedState() {
+            static thread_local SeedState state;
+            return state;
+        }
+    };
+
+    // Fixed, fast hash of a 5-tuple for in-memory hash tables and flow
+    // partitioning (not a sketch hash: it has no per-instance seed).
+    struct FlowKeyHash {
+        uint64_t operator()(const FlowKey<13> &flowkey) const {
+            const uint8_t *k = flowkey.cKey();
+            uint64_t a, b = 0;
+            std::memcpy(&a, k, 8);
+            std::memcpy(&b, k + 8, 5);
+            uint64_t h = a * 0x9E3779B97F4A7C15ULL ^ (b + 0x632BE59BD9B4E019ULL);
+            h ^= h >> 32;
+            h *= 0xD6E8FEB86659FD93ULL;
+            h ^= h >> 32;
+            h *= 0xD6E8FEB86659FD93ULL;
+            h ^= h >> 32;
+            return h;
+        }
+
+        // Partition in [0, n) from the high half of the hash, so the members
+        // of one partition still spread over the low bits that hash tables
+        // index with.
+        static uint32_t partition(const FlowKey<13> &flowkey, uint32_t n) {
+            uint32_t hi = static_cast<uint32_t>(FlowKeyHash()(flowkey) >> 32);
+            return static_cast<uint32_t>((static_cast<uint64_t>(hi) * n) >> 32);
+        }
     };
 
 } // namespace hash